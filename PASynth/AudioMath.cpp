@@ -1,17 +1,87 @@
 #include <math.h>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
 #include "AudioMath.h"
-#include "prob.h"
 #include <iostream>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
 #define SAMPLE_RATE   (48000)
 #define PI 3.14159265f
+#define MAX_MIPMAP_HARMONICS (2048) // enough for a 12Hz saw at 48k, keeps big tables quick to build
 
 float BaseSound::GetSample()
 	{
 		return 0.0f;
 	}
 
+void BaseSound::ProcessBlock(float* out, int frames)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			out[i] = GetSample();
+		}
+	}
+
+void BaseSound::SetParam(int param, float value)
+	{
+		(void)param;
+		(void)value;
+	}
+
+void BaseSound::Process(float* out, int frames)
+	{
+		while (frames > 0)
+		{
+			int blockFrames = std::min(frames, MAX_BLOCK_SIZE);
+			ProcessBlock(out, blockFrames);
+			out += blockFrames;
+			frames -= blockFrames;
+		}
+	}
+
+void BaseSound::ProcessBlockChannels(float* const* out, int channels, int frames)
+	{
+		ProcessBlock(out[0], frames);
+		for (int c = 1; c < channels; c++)
+		{
+			memcpy(out[c], out[0], frames * sizeof(float));
+		}
+	}
+
+void BaseSound::ProcessChannels(float* const* out, int channels, int frames)
+	{
+		channels = std::min(channels, MAX_CHANNELS); // planes past MAX_CHANNELS are left untouched
+		float* planes[MAX_CHANNELS];
+		for (int c = 0; c < channels; c++)
+		{
+			planes[c] = out[c];
+		}
+		while (frames > 0)
+		{
+			int blockFrames = std::min(frames, MAX_BLOCK_SIZE);
+			ProcessBlockChannels(planes, channels, blockFrames);
+			for (int c = 0; c < channels; c++)
+			{
+				planes[c] += blockFrames;
+			}
+			frames -= blockFrames;
+		}
+	}
+
+int BaseSound::GetChannels()
+	{
+		return 1;
+	}
+
 
 
 /*
@@ -100,21 +170,237 @@ void ReverseTable(waveTable* tab)
 }
 
 
+/*
+BAND-LIMITED MIPMAPS
+*/
+
+static std::map<std::pair<int, int>, WaveMipmap*> mipmaps;
+static std::mutex mipmapMutex;
+
+// one cycle from its first harmonics, padded with wrapped guard samples for interpolation
+waveTable* MakeBandLimitedTable(waveShape shape, int tabSize, int harmonics)
+{
+	std::vector<double> sine(tabSize);
+	for (int i = 0; i < tabSize; i++)
+	{
+		sine[i] = sin(2.0 * PI * i / tabSize);
+	}
+
+	std::vector<double> wave(tabSize, 0.0);
+	if (shape == sineWave)
+	{
+		wave = sine;
+	}
+	else
+	{
+		for (int k = 1; k <= harmonics; k++) // a rising saw
+		{
+			// lanczos sigma keeps the gibbs overshoot from pushing the wave much past +-1
+			double x = PI * k / (harmonics + 1);
+			double amp = -2.0 / (PI * k) * (sin(x) / x);
+			for (int i = 0; i < tabSize; i++)
+			{
+				wave[i] += amp * sine[(int)(((long long)k * i) % tabSize)];
+			}
+		}
+	}
+
+	waveTable* wf = new waveTable(tabSize + 3);
+	for (int i = 0; i < tabSize + 3; i++)
+	{
+		(*wf)[i] = (float)wave[(i + tabSize - 1) % tabSize];
+	}
+	return wf;
+}
+
+WaveMipmap::WaveMipmap(waveShape shape, int tabSize)
+{
+	this->tabSize = tabSize;
+
+	if (shape == sineWave) // a sine has nothing to alias
+	{
+		harmonics = 1;
+		levels.push_back(GetSharedTable(mipmapSineTable, tabSize));
+		return;
+	}
+
+	harmonics = std::max(std::min(tabSize / 2, MAX_MIPMAP_HARMONICS), 1);
+	for (int h = harmonics; h >= 1; h /= 2)
+	{
+		levels.push_back(GetSharedTable(mipmapSawTable, tabSize, h));
+	}
+}
+
+WaveMipmap* WaveMipmap::Get(waveShape shape, int tabSize)
+{
+	std::lock_guard<std::mutex> lock(mipmapMutex);
+	std::pair<int, int> key(shape, tabSize);
+	std::map<std::pair<int, int>, WaveMipmap*>::iterator found = mipmaps.find(key);
+	if (found != mipmaps.end())
+	{
+		return found->second;
+	}
+	WaveMipmap* mipmap = new WaveMipmap(shape, tabSize);
+	mipmaps[key] = mipmap;
+	return mipmap;
+}
+
+int WaveMipmap::GetSize()
+{
+	return tabSize;
+}
+
+int WaveMipmap::GetLevels()
+{
+	return (int)levels.size();
+}
+
+const float* WaveMipmap::GetLevel(int level)
+{
+	return levels[level]->data() + 1;
+}
+
+int WaveMipmap::LevelFor(float increment)
+{
+	float allowed = 0.5f / std::max(fabs(increment), 1e-9f); // harmonics that fit under nyquist
+	int level = 0;
+	while (level < (int)levels.size() - 1 && (harmonics >> level) > allowed)
+	{
+		level++;
+	}
+	return level;
+}
+
+
 WavePlayer::WavePlayer(waveTable* sourceWave)
 {
-	this->sourceWave = sourceWave;
+	planes[0] = sourceWave->data();
+	this->size = (int)sourceWave->size();
+}
+
+WavePlayer::WavePlayer(SampleBuffer* source)
+{
+	channels = std::min(source->GetChannels(), MAX_CHANNELS);
+	for (int c = 0; c < channels; c++)
+	{
+		planes[c] = source->GetChannel(c);
+	}
+	this->size = source->GetFrames();
+}
+
+WavePlayer::WavePlayer(const float* samples, int frames, int channels)
+{
+	this->channels = std::min(channels, MAX_CHANNELS);
+	stride = channels;
+	for (int c = 0; c < this->channels; c++)
+	{
+		planes[c] = samples + c;
+	}
+	this->size = frames;
+}
+
+int WavePlayer::GetChannels()
+{
+	return channels;
+}
+
+void WavePlayer::Seek(int frame)
+{
+	index = (size > 0) ? ((frame % size) + size) % size : 0;
 }
 
 float WavePlayer::GetSample()
 {
 	float newSamp = 0;
-	if (index >= (int)sourceWave->size())
+	if (size == 0)
+	{
+		return newSamp;
+	}
+	if (index >= size)
 	{
 		index = 0;
 	}
-	newSamp = (*sourceWave)[index];
+	for (int c = 0; c < channels; c++)
+	{
+		newSamp += planes[c][index * stride];
+	}
 	index++;
-	return newSamp;
+	return (channels == 1) ? newSamp : newSamp / channels;
+}
+
+void WavePlayer::CopyRun(int channel, float* out, int frames)
+{
+	const float* in = planes[channel] + index * stride;
+	if (stride == 1)
+	{
+		memcpy(out, in, frames * sizeof(float));
+		return;
+	}
+	for (int i = 0; i < frames; i++)
+	{
+		out[i] = in[i * stride];
+	}
+}
+
+void WavePlayer::ProcessBlock(float* out, int frames)
+{
+	if (size == 0)
+	{
+		std::fill(out, out + frames, 0.0f);
+		return;
+	}
+	float scale = 1.0f / channels;
+	while (frames > 0)
+	{
+		if (index >= size)
+		{
+			index = 0;
+		}
+		int run = std::min(frames, size - index); // copy straight up to the wrap point
+		CopyRun(0, out, run);
+		if (channels > 1) // mix the rest down on top
+		{
+			for (int c = 1; c < channels; c++)
+			{
+				const float* in = planes[c] + index * stride;
+				for (int i = 0; i < run; i++)
+				{
+					out[i] += in[i * stride];
+				}
+			}
+			for (int i = 0; i < run; i++)
+			{
+				out[i] *= scale;
+			}
+		}
+		index += run;
+		out += run;
+		frames -= run;
+	}
+}
+
+void WavePlayer::ProcessBlockChannels(float* const* out, int outChannels, int frames)
+{
+	if (outChannels == 1 || size == 0)
+	{
+		BaseSound::ProcessBlockChannels(out, outChannels, frames);
+		return;
+	}
+	int done = 0;
+	while (done < frames)
+	{
+		if (index >= size)
+		{
+			index = 0;
+		}
+		int run = std::min(frames - done, size - index);
+		for (int c = 0; c < outChannels; c++)
+		{
+			CopyRun(c % channels, out[c] + done, run);
+		}
+		index += run;
+		done += run;
+	}
 }
 
 
@@ -125,27 +411,41 @@ float WavePlayer::GetSample()
 GRANULAR SYNTHESIS
 */
 
-Grain::Grain(std::vector<float>* sourceWave, int start, int finish, float rate, int delay, waveTable* window)
+Grain::Grain(SampleBuffer* source, int start, int finish, float rate, int delay, const waveTable* window)
 {
 	this->start = start;
 	this->finish = finish;
 	this->length = finish - start;
 	this->index = start;
-	this->sourceWave = sourceWave;
+	this->source = source;
 	this->window = window;
 	this->delay = delay;
-	this->rate = rate;
+	this->rate = std::max(rate, MIN_GRAIN_RATE); // the direction comes from start and finish, never the rate
 	playing = true;
+	ScaleWindow();
+}
+
+void Grain::ScaleWindow()
+{
+	windowScale = (length == 0) ? 0.0f : (float)window->size() / abs(length);
 }
 
 float Grain::GetSample() 
 {
 	int intIndex = (int)floor(index);
 
-	float returnGrain = (*sourceWave)[intIndex];
+	float returnGrain = 0;
+	int channels = source->GetChannels();
+	for (int c = 0; c < channels; c++)
+	{
+		returnGrain += source->GetChannel(c)[intIndex];
+	}
+	if (channels > 1)
+	{
+		returnGrain /= channels;
+	}
 	
-	this->finish;
-	int absIndex = intIndex - start;
+	int absIndex = std::min((int)(abs(intIndex - start) * windowScale), (int)window->size() - 1); // a reverse grain's last step can land on size()
 	float windowSamp = (*window)[absIndex];
 	returnGrain *= windowSamp;
 	if (finish > start)
@@ -175,7 +475,8 @@ void Grain::UpdateParams(int start, int finish, float rate, int delay)
 	this->finish = finish;
 	length = finish - start;
 	this->delay = delay;
-	this->rate = rate;
+	this->rate = std::max(rate, MIN_GRAIN_RATE);
+	ScaleWindow();
 }
 
 bool Grain::IsPlaying()
@@ -188,6 +489,16 @@ void Grain::Play()
 	playing = true;
 }
 
+void Grain::Stop()
+{
+	playing = false;
+}
+
+void Grain::AddDelay(int frames)
+{
+	delay += frames;
+}
+
 bool Grain::CheckDelay()
 {
 	int temp = this->delay;
@@ -198,22 +509,124 @@ bool Grain::CheckDelay()
 	return (temp > 0);
 }
 
-GranularSynth::GranularSynth(std::vector<float>* sourceWave, int start, int finish, float rate, int wait, windowType wind)
+void Grain::Render(float* const* out, int channels, int* grainCount, int frames)
+{
+	int i = std::min(delay, frames); // frames still inside the delay stay silent
+	if (i > 0)
+	{
+		delay -= i;
+	}
+	else
+	{
+		i = 0;
+	}
+
+	int sourceChannels = std::min(source->GetChannels(), MAX_CHANNELS);
+	const float* planes[MAX_CHANNELS];
+	for (int c = 0; c < sourceChannels; c++)
+	{
+		planes[c] = source->GetChannel(c);
+	}
+	bool mono = (channels == 1 && sourceChannels == 1);
+	float mixScale = 1.0f / sourceChannels;
+
+	const float* windowData = window->data();
+	int windowLast = (int)window->size() - 1; // a reverse grain's last step can land on size()
+	for (; i < frames && playing; i++)
+	{
+		int intIndex = (int)floor(index);
+		float windowSamp = windowData[std::min((int)(abs(intIndex - start) * windowScale), windowLast)];
+		if (mono)
+		{
+			out[0][i] += planes[0][intIndex] * windowSamp;
+		}
+		else if (channels == 1) // mixed down
+		{
+			float sum = 0;
+			for (int c = 0; c < sourceChannels; c++)
+			{
+				sum += planes[c][intIndex];
+			}
+			out[0][i] += sum * mixScale * windowSamp;
+		}
+		else
+		{
+			for (int c = 0; c < channels; c++)
+			{
+				out[c][i] += planes[c % sourceChannels][intIndex] * windowSamp;
+			}
+		}
+		grainCount[i]++;
+
+		if (finish > start)
+		{
+			index += rate;
+			if (index >= (float)finish)
+			{
+				playing = false;
+			}
+		}
+		else if (start > finish)
+		{
+			index -= rate;
+			if (index <= (float)finish)
+			{
+				playing = false;
+			}
+		}
+	}
+}
+
+GranularSynth::GranularSynth(waveTable* sourceWave, int start, int finish, float rate, int wait, windowType wind, int maxGrains)
+	: GranularSynth(new SampleBuffer(sourceWave), start, finish, rate, wait, wind, maxGrains)
 {
-	this->sourceWave = sourceWave;
-	this->window = MakeHannTable(abs(finish - start)); //enable other windows sometime
+}
+
+GranularSynth::GranularSynth(SampleBuffer* source, int start, int finish, float rate, int wait, windowType wind, int maxGrains)
+{
+	this->source = source;
+	this->windowRef = GetSharedTable(hannTable, abs(finish - start)); //enable other windows sometime
+	this->window = windowRef.get();
 	this->start = start;
 	this->finish = finish;
 	this->wait = wait;
 	this->rate = rate;
-	grains->push_back(new Grain(sourceWave, start, finish, rate, 0, window));
+	AllocateGrains(maxGrains);
+	AcquireGrain()->Play();
 }
 
-void GranularSynth::NewGrain()
+void GranularSynth::AllocateGrains(int maxGrains)
 {
-	Grain* newGrain = new Grain(sourceWave, start, finish, rate, 0, this->window); // can I do this mid audio loop?
-	grains->push_back(newGrain);
-	newGrain->Play();
+	maxGrains = std::max(maxGrains, 1); // the constructors start a grain playing straight away
+	this->maxGrains = maxGrains;
+	freeGrains = new int[maxGrains];
+	activeGrains = new int[maxGrains];
+	for (int i = 0; i < maxGrains; i++)
+	{
+		Grain* grain = new Grain(source, start, finish, rate, 0, window);
+		grain->Stop();
+		grains->push_back(grain);
+		freeGrains[i] = maxGrains - 1 - i; // hand out the lowest slots first
+	}
+	freeCount = maxGrains;
+	activeCount = 0;
+}
+
+Grain* GranularSynth::AcquireGrain()
+{
+	if (freeCount == 0)
+	{
+		return nullptr;
+	}
+	int slot = freeGrains[--freeCount];
+	activeGrains[activeCount++] = slot;
+	return (*grains)[slot];
+}
+
+void GranularSynth::ReleaseGrain(int activeIndex)
+{
+	freeGrains[freeCount++] = activeGrains[activeIndex];
+	activeGrains[activeIndex] = activeGrains[--activeCount];
 }
 
 void GranularSynth::RestartGrain(Grain* grain)
@@ -223,60 +636,230 @@ void GranularSynth::RestartGrain(Grain* grain)
 
 }
 
+Grain* GranularSynth::SpawnGrain()
+{
+	index = 0;
+	Grain* g = AcquireGrain();
+	if (g == nullptr)
+	{
+		droppedGrains++;
+	}
+	else
+	{
+		RestartGrain(g);
+	}
+	return g;
+}
+
 float GranularSynth::GetSample() 
 {
 	if (index >= wait)
 	{
-		if (oscCtrl)
+		SpawnGrain();
+	}
+
+	float fullOutput = 0;
+	int total_grains = 0;
+
+	for (int i = 0; i < activeCount;) 
+	{
+		Grain* g = (*grains)[activeGrains[i]];
+		if (!(g->CheckDelay()))
 		{
-			if (storedParams[0] > 0)
-			{
-				//std::cout << "received '/wek/inputs' message in GranularSynth with arguments: " << storedParams[0] << " " << storedParams[1] << " " << storedParams[2] << "\n";
-				int newStart = round(storedParams[0]);
-				int newFinish = start + round(storedParams[1]);
-				int newDens = round(storedParams[2]);
+			fullOutput += g->GetSample();
+			total_grains++;
+		}
+
+		if (g->IsPlaying())
+		{
+			i++;
+		}
+		else
+		{
+			ReleaseGrain(i); // swaps the last active grain into i
+		}
+	}
+	if (total_grains > 0)
+	{
+		fullOutput /= total_grains;
+	}
+
+	index++;
+	return fullOutput;
+}
+
+void GranularSynth::ProcessBlock(float* out, int frames)
+{
+	float* planes[1] = { out };
+	RenderBlock(planes, 1, frames);
+}
+
+void GranularSynth::ProcessBlockChannels(float* const* out, int channels, int frames)
+{
+	RenderBlock(out, channels, frames);
+}
+
+int GranularSynth::GetChannels()
+{
+	return source->GetChannels();
+}
+
+void GranularSynth::RenderBlock(float* const* out, int channels, int frames)
+{
+	if (workerPool != nullptr)
+	{
+		RenderBlockThreaded(out, channels, frames);
+		return;
+	}
+
+	int grainCount[MAX_BLOCK_SIZE] = {};
+	for (int c = 0; c < channels; c++)
+	{
+		std::fill(out[c], out[c] + frames, 0.0f);
+	}
 
-				UpdateParams(newStart, newFinish, newDens);
+	// render the grains in runs between spawns, so the grain set is fixed for each run
+	float* runOut[MAX_CHANNELS];
+	int frame = 0;
+	while (frame < frames)
+	{
+		if (index >= wait)
+		{
+			SpawnGrain();
+		}
+		int run = std::min(frames - frame, std::max(wait - index, 1));
+		for (int c = 0; c < channels; c++)
+		{
+			runOut[c] = out[c] + frame;
+		}
+
+		for (int i = 0; i < activeCount;)
+		{
+			Grain* g = (*grains)[activeGrains[i]];
+			g->Render(runOut, channels, grainCount + frame, run);
+			if (g->IsPlaying())
+			{
+				i++;
+			}
+			else
+			{
+				ReleaseGrain(i);
 			}
-			
 		}
 
-		index = 0;
-		bool foundNotPlayingGrain = false;
-		for (size_t i = 0; i < grains->size(); i++)
+		index += run;
+		frame += run;
+	}
+
+	for (int c = 0; c < channels; c++)
+	{
+		float* plane = out[c];
+		for (int i = 0; i < frames; i++)
 		{
-			Grain* g = (*grains)[i];
-			if (!g->IsPlaying())
+			if (grainCount[i] > 0)
 			{
-				RestartGrain(g);
-				foundNotPlayingGrain = true;
-				break;
+				plane[i] /= grainCount[i];
 			}
 		}
-		if (!foundNotPlayingGrain)
+	}
+}
+
+void GranularSynth::RenderBlockThreaded(float* const* out, int channels, int frames)
+{
+	// start all of this block's grains up front, each held back until the frame it was due
+	int frame = 0;
+	while (frame < frames)
+	{
+		if (index >= wait)
 		{
-			NewGrain();
+			Grain* g = SpawnGrain();
+			if (g != nullptr)
+			{
+				g->AddDelay(frame);
+			}
 		}
+		int run = std::min(frames - frame, std::max(wait - index, 1));
+		index += run;
+		frame += run;
 	}
 
-	float fullOutput = 0;
-	int total_grains = 0;
+	MixPartitions(out, channels, frames);
+}
 
-	for (size_t i = 0; i < grains->size(); i++) 
+void GranularSynth::MixPartitions(float* const* out, int channels, int frames)
+{
+	blockFrames = frames;
+	blockChannels = channels;
+	workerPool->Run(this, GRAIN_PARTITIONS, (double)frames / SAMPLE_RATE);
+
+	// sum the partitions in a fixed order so the mix is the same for any number of threads
+	int grainCount[MAX_BLOCK_SIZE] = {};
+	for (int c = 0; c < channels; c++)
+	{
+		std::fill(out[c], out[c] + frames, 0.0f);
+	}
+	for (int p = 0; p < GRAIN_PARTITIONS; p++)
 	{
-		Grain* g = (*grains)[i];
-		if (g->IsPlaying() && !(g->CheckDelay()))
+		for (int c = 0; c < channels; c++)
 		{
-			fullOutput += g->GetSample();
-			total_grains++;
+			float* mix = partitionMix + (p * MAX_CHANNELS + c) * MAX_BLOCK_SIZE;
+			float* plane = out[c];
+			for (int i = 0; i < frames; i++)
+			{
+				plane[i] += mix[i];
+			}
+		}
+		int* count = partitionCount + p * MAX_BLOCK_SIZE;
+		for (int i = 0; i < frames; i++)
+		{
+			grainCount[i] += count[i];
+		}
+	}
+	for (int c = 0; c < channels; c++)
+	{
+		float* plane = out[c];
+		for (int i = 0; i < frames; i++)
+		{
+			if (grainCount[i] > 0)
+			{
+				plane[i] /= grainCount[i];
+			}
 		}
-		
-		// unneeded grains could possibly be cleaned up here
 	}
-	fullOutput /= total_grains;
 
-	index++;
-	return fullOutput;
+	// grains that finished during the block can only be reused from the next one
+	for (int i = 0; i < activeCount;)
+	{
+		if ((*grains)[activeGrains[i]]->IsPlaying())
+		{
+			i++;
+		}
+		else
+		{
+			ReleaseGrain(i);
+		}
+	}
+}
+
+void GranularSynth::RunTask(int partition)
+{
+	float* mix[MAX_CHANNELS];
+	for (int c = 0; c < blockChannels; c++)
+	{
+		mix[c] = partitionMix + (partition * MAX_CHANNELS + c) * MAX_BLOCK_SIZE;
+		std::fill(mix[c], mix[c] + blockFrames, 0.0f);
+	}
+	int* count = partitionCount + partition * MAX_BLOCK_SIZE;
+	std::fill(count, count + blockFrames, 0);
+
+	for (int slot = partition; slot < maxGrains; slot += GRAIN_PARTITIONS)
+	{
+		Grain* g = (*grains)[slot];
+		if (g->IsPlaying())
+		{
+			g->Render(mix, blockChannels, count, blockFrames);
+		}
+	}
 }
 
 void GranularSynth::UpdateParams(int newStart, int newFinish, int wait)
@@ -284,23 +867,83 @@ void GranularSynth::UpdateParams(int newStart, int newFinish, int wait)
 	start = newStart;
 	finish = newFinish;
 	this->wait = wait;
+	KeepInSource();
 }
 
-void GranularSynth::AddExtCtrl(float* storedParams)
+void GranularSynth::KeepInSource()
 {
-	oscCtrl = true;
-	this->storedParams = storedParams;
+	int last = std::max(source->GetFrames() - 1, 0);
+	start = std::max(0, std::min(start, last));
+	finish = std::max(0, std::min(finish, last));
+	if (finish == start) // a grain only moves towards a different finish, so one with no length would never end
+	{
+		finish++; // a forward grain stops before reading its finish, so this is safe on the last frame too
+	}
+}
+
+void GranularSynth::SetParam(int param, float value)
+{
+	switch (param)
+	{
+	case grainStart: // moves the grain, keeping its length
+		finish += (int)round(value) - start;
+		start = (int)round(value);
+		KeepInSource();
+		break;
+	case grainLength:
+		finish = start + (int)round(value);
+		KeepInSource();
+		break;
+	case grainWait:
+		wait = (int)round(value);
+		break;
+	case grainRate:
+		rate = std::max(value, MIN_GRAIN_RATE);
+		break;
+	}
+}
+
+int GranularSynth::GetActiveGrains()
+{
+	return activeCount;
+}
+
+int GranularSynth::GetDroppedGrains()
+{
+	return droppedGrains;
+}
+
+void GranularSynth::EnableWorkers(int threads)
+{
+	partitionMix = new float[GRAIN_PARTITIONS * MAX_CHANNELS * MAX_BLOCK_SIZE];
+	partitionCount = new int[GRAIN_PARTITIONS * MAX_BLOCK_SIZE];
+	workerPool = new WorkerPool(threads);
+}
+
+int GranularSynth::GetWorkers()
+{
+	return (workerPool == nullptr) ? 1 : workerPool->GetWorkers();
+}
+
+float GranularSynth::GetWorkerLoad(int worker)
+{
+	return (workerPool == nullptr) ? 0.0f : workerPool->GetLoad(worker);
 }
 
 MovingGranularSynth::MovingGranularSynth(waveTable* sourceWave, BaseSound* startPlayer, BaseSound* lengthPlayer, 
-	BaseSound* densityPlayer, windowType wind)
+	BaseSound* densityPlayer, windowType wind, int maxGrains)
+	: MovingGranularSynth(new SampleBuffer(sourceWave), startPlayer, lengthPlayer, densityPlayer, wind, maxGrains)
+{
+}
+
+MovingGranularSynth::MovingGranularSynth(SampleBuffer* source, BaseSound* startPlayer, BaseSound* lengthPlayer, 
+	BaseSound* densityPlayer, windowType wind, int maxGrains)
 {
-	this->sourceWave = sourceWave;
-	this->window = this->window = MakeHannTable(abs(finish - start));
+	this->source = source;
 	this->startPlayer = startPlayer;
 	this->lengthPlayer = lengthPlayer;
 	this->densityPlayer = densityPlayer;
-
+	this->rate = 1.0f; // the players don't move the rate, grains play at the source's speed unless SetParam changes it
 
 	this->start = (int)startPlayer->GetSample();
 	this->finish = (int)lengthPlayer->GetSample() + this->start;
@@ -308,72 +951,277 @@ MovingGranularSynth::MovingGranularSynth(waveTable* sourceWave, BaseSound* start
 	{
 		this->finish++;
 	}
+	this->windowRef = GetSharedTable(hannTable, abs(finish - start)); // sized once start and finish are known
+	this->window = windowRef.get();
 
 	this->wait = (int)densityPlayer->GetSample();
-	grains->push_back(new Grain(sourceWave, start, finish, rate, 0, window));
+	AllocateGrains(maxGrains);
+	AcquireGrain()->Play();
 }
 
-float MovingGranularSynth::GetSample()
+void MovingGranularSynth::UpdateFromPlayers(float startSamp, float lengthSamp, float densitySamp)
 {
-	this->start = (int)startPlayer->GetSample();
-	this->finish = (int)lengthPlayer->GetSample() + this->start;
+	this->start = (int)startSamp;
+	this->finish = (int)lengthSamp + this->start;
 	if (this->finish == this->start)
 	{
 		this->finish++;
 	}
-	this->wait = (int)densityPlayer->GetSample();
+	this->wait = (int)densitySamp;
+}
+
+float MovingGranularSynth::GetSample()
+{
+	float startSamp = startPlayer->GetSample();
+	float lengthSamp = lengthPlayer->GetSample();
+	UpdateFromPlayers(startSamp, lengthSamp, densityPlayer->GetSample());
 	return GranularSynth::GetSample();
 }
 
+void MovingGranularSynth::RenderBlock(float* const* out, int channels, int frames)
+{
+	float startBlock[MAX_BLOCK_SIZE];
+	float lengthBlock[MAX_BLOCK_SIZE];
+	float densityBlock[MAX_BLOCK_SIZE];
+	startPlayer->Process(startBlock, frames);
+	lengthPlayer->Process(lengthBlock, frames);
+	densityPlayer->Process(densityBlock, frames);
+
+	if (workerPool != nullptr)
+	{
+		// the players only matter when a grain spawns, so spawn the block's grains frame by frame and render them in one dispatch
+		for (int i = 0; i < frames; i++)
+		{
+			UpdateFromPlayers(startBlock[i], lengthBlock[i], densityBlock[i]);
+			if (index >= wait)
+			{
+				Grain* g = SpawnGrain();
+				if (g != nullptr)
+				{
+					g->AddDelay(i);
+				}
+			}
+			index++;
+		}
+		MixPartitions(out, channels, frames);
+		return;
+	}
+
+	// the players move the grain parameters every frame, so step the synth one frame at a time
+	float* frameOut[MAX_CHANNELS];
+	for (int i = 0; i < frames; i++)
+	{
+		UpdateFromPlayers(startBlock[i], lengthBlock[i], densityBlock[i]);
+		for (int c = 0; c < channels; c++)
+		{
+			frameOut[c] = out[c] + i;
+		}
+		GranularSynth::RenderBlock(frameOut, channels, 1);
+	}
+}
+
+
+static std::atomic<uint64_t> nextRandSeed(1); // seeds for SRands not given one, in construction order
 
 SRand::SRand(double low, double mid, double high, double tight)
+	: SRand(low, mid, high, tight, nextRandSeed++)
+{
+}
+
+SRand::SRand(double low, double mid, double high, double tight, uint64_t seed)
+	: generator(seed)
 {
 	this->low = low;
 	this->mid = mid;
 	this->high = high;
 	this->tight = tight;
+	this->range = std::max(high - mid, mid - low);
+
+	/*
+	prob() takes a random side of mid, goes pow(u, tight) * range from it and redraws whenever that lands outside low to high.
+	A draw on the upper side is kept when u is under pow((high - mid) / range, 1 / tight), and likewise below,
+	so what it returns is u uniform over the two reaches laid end to end. Drawing that directly gives the same
+	distribution with a single uniform and no loop, however lopsided the range is.
+	*/
+	upperReach = (range > 0) ? pow((high - mid) / range, 1.0 / tight) : 0.0;
+	lowerReach = (range > 0) ? pow((mid - low) / range, 1.0 / tight) : 0.0;
 }
 
+void SRand::SetSeed(uint64_t seed)
+{
+	generator.Seed(seed);
+}
+
+void SRand::EnableTable(int size)
+{
+	shapeTable.resize(size + 1); // one guard point so u just under 1 can interpolate
+	for (int i = 0; i <= size; i++)
+	{
+		shapeTable[i] = (float)pow((double)i / size, tight);
+	}
+}
+
+inline double SRand::Shape(double u)
+{
+	if (shapeTable.empty())
+	{
+		return pow(u, tight);
+	}
+	double x = u * (shapeTable.size() - 1);
+	int i = (int)x;
+	double frac = x - i;
+	return shapeTable[i] + (shapeTable[i + 1] - shapeTable[i]) * frac;
+}
+
+inline double SRand::Place(double w)
+{
+	if (w < upperReach)
+	{
+		return mid + Shape(w) * range;
+	}
+	return mid - Shape(w - upperReach) * range;
+}
+
+#if defined(__AVX2__)
+/*
+Place for four draws at once from a table of tight's curve, a gather and a lerp per lane.
+With a table, GetVal and Fill both shape through this, so a build free to fuse multiplies and adds
+can't leave the scalar and vector paths rounding differently.
+*/
+static inline __m256d PlaceFromTable(__m256d w, const float* table, double steps, double upperReach, double mid, double range)
+{
+	__m256d upper = _mm256_set1_pd(upperReach);
+	__m256d above = _mm256_cmp_pd(w, upper, _CMP_LT_OQ); // lanes that land above mid
+	__m256d u = _mm256_sub_pd(w, _mm256_andnot_pd(above, upper));
+	__m256d x = _mm256_mul_pd(u, _mm256_set1_pd(steps));
+	__m128i index = _mm256_cvttpd_epi32(x);
+	__m256d frac = _mm256_sub_pd(x, _mm256_cvtepi32_pd(index));
+	__m128 t0 = _mm_i32gather_ps(table, index, 4);
+	__m128 step = _mm_sub_ps(_mm_i32gather_ps(table + 1, index, 4), t0); // in float, as Shape does
+	__m256d shaped = _mm256_add_pd(_mm256_cvtps_pd(t0), _mm256_mul_pd(_mm256_cvtps_pd(step), frac));
+	__m256d offset = _mm256_mul_pd(shaped, _mm256_set1_pd(range));
+	offset = _mm256_blendv_pd(_mm256_sub_pd(_mm256_setzero_pd(), offset), offset, above);
+	return _mm256_add_pd(_mm256_set1_pd(mid), offset);
+}
+#endif
+
 double SRand::GetVal()
 {
-	seed++;
-	srrand(seed);
-	return prob(this->low, this->mid, this->high, this->tight);
+	double w = generator.NextDouble() * (upperReach + lowerReach);
+#if defined(__AVX2__)
+	if (!shapeTable.empty())
+	{
+		return _mm256_cvtsd_f64(PlaceFromTable(_mm256_set1_pd(w), shapeTable.data(), (double)(shapeTable.size() - 1), upperReach, mid, range));
+	}
+#endif
+	return Place(w);
+}
+
+void SRand::Fill(double* out, int n)
+{
+	// the generator is serial, so draw every uniform first and shape them in a second loop with no dependencies
+	double reach = upperReach + lowerReach;
+	for (int i = 0; i < n; i++)
+	{
+		out[i] = generator.NextDouble() * reach;
+	}
+#if defined(__AVX2__)
+	if (!shapeTable.empty())
+	{
+		const float* table = shapeTable.data();
+		double steps = (double)(shapeTable.size() - 1);
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			_mm256_storeu_pd(out + i, PlaceFromTable(_mm256_loadu_pd(out + i), table, steps, upperReach, mid, range));
+		}
+		if (i < n) // the last few go through the same lanes, padded with draws that are thrown away
+		{
+			double tail[4] = {};
+			std::copy(out + i, out + n, tail);
+			_mm256_storeu_pd(tail, PlaceFromTable(_mm256_loadu_pd(tail), table, steps, upperReach, mid, range));
+			std::copy(tail, tail + (n - i), out + i);
+		}
+		return;
+	}
+#endif
+	for (int i = 0; i < n; i++) // pow has no vector form here, so without the table this stays one call per draw
+	{
+		out[i] = Place(out[i]);
+	}
+}
+
+RandStream::RandStream(SRand* source)
+{
+	this->source = source;
+	TopUp();
+}
+
+void RandStream::TopUp()
+{
+	int missing = RAND_STREAM_SIZE - available;
+	int write = (read + available) & (RAND_STREAM_SIZE - 1);
+	int first = std::min(missing, RAND_STREAM_SIZE - write); // up to the end of the ring, then wrap
+	source->Fill(values + write, first);
+	source->Fill(values, missing - first);
+	available = RAND_STREAM_SIZE;
+}
+
+double RandStream::Next()
+{
+	if (available == 0)
+	{
+		TopUp();
+	}
+	double value = values[read];
+	read = (read + 1) & (RAND_STREAM_SIZE - 1);
+	available--;
+	return value;
 }
 
 SGranSynth::SGranSynth(waveTable* sourceWave, int start, int finish, float rate, int wait, 
-	windowType wind, SRand* randStart, SRand* randDelay, SRand* randRate)
+	windowType wind, SRand* randStart, SRand* randDelay, SRand* randRate, int maxGrains)
+	: SGranSynth(new SampleBuffer(sourceWave), start, finish, rate, wait, wind, randStart, randDelay, randRate, maxGrains)
+{
+}
+
+SGranSynth::SGranSynth(SampleBuffer* source, int start, int finish, float rate, int wait, 
+	windowType wind, SRand* randStart, SRand* randDelay, SRand* randRate, int maxGrains)
 {
-	this->sourceWave = sourceWave;
+	this->source = source;
 	this->start = start;
 	this->finish = finish;
 	this->rate = rate;
 	this->wait = wait;
-	this->window = this->window = MakeHannTable(abs(finish - start));
+	this->windowRef = GetSharedTable(hannTable, abs(finish - start));
+	this->window = windowRef.get();
 	this->randStart = randStart;
 	this->randDelay = randDelay;
 	this->randRate = randRate;
-}
-
-void SGranSynth::NewGrain()
-{
-	int offset = (int)round(randStart->GetVal()); //get rid of this rounding
-	int delay = (int)round(randDelay->GetVal());
-	Grain* newGrain = new Grain(sourceWave, start + offset, finish + offset, rate + randRate->GetVal(), delay, this->window); // can I do this mid audio loop?
-	grains->push_back(newGrain);
-	newGrain->Play();
-	
+	this->startStream = new RandStream(randStart);
+	this->delayStream = new RandStream(randDelay);
+	this->rateStream = new RandStream(randRate);
+	AllocateGrains(maxGrains);
 }
 
 void SGranSynth::RestartGrain(Grain* grain)
 {
-	int offset = (int)round(randStart->GetVal());
-	int delay = (int)round(randDelay->GetVal());
-	grain->UpdateParams(start + offset, finish + offset, rate + randRate->GetVal(), delay);
+	int offset = (int)round(startStream->Next());
+	int delay = (int)round(delayStream->Next());
+	grain->UpdateParams(start + offset, finish + offset, rate + rateStream->Next(), delay);
 	grain->Play();
 
 }
 
+void SGranSynth::RenderBlock(float* const* out, int channels, int frames)
+{
+	// a block spawns at most one grain per frame, so after topping up no draw happens mid block
+	startStream->TopUp();
+	delayStream->TopUp();
+	rateStream->TopUp();
+	GranularSynth::RenderBlock(out, channels, frames);
+}
+
 
 
 /*
@@ -392,6 +1240,16 @@ float SimpleLP::GetSample()
 		return curInp;
 	}
 
+void SimpleLP::ProcessBlock(float* out, int frames)
+	{
+		inputSig->Process(out, frames);
+		for (int i = 0; i < frames; i++)
+		{
+			lastInput = (out[i] * 0.5f) + lastInput * 0.5f;
+			out[i] = lastInput;
+		}
+	}
+
 
 SimpleHP::SimpleHP(BaseSound* input)
 	{
@@ -405,29 +1263,81 @@ float SimpleHP::GetSample()
 		return curInp;
 	}
 
+void SimpleHP::ProcessBlock(float* out, int frames)
+	{
+		inputSig->Process(out, frames);
+		for (int i = 0; i < frames; i++)
+		{
+			lastInput = (out[i] * 0.5f) - lastInput * 0.5f;
+			out[i] = lastInput;
+		}
+	}
 
-SimpleFir::SimpleFir(BaseSound* input, int order, std::vector<float>* coefs)
+
+float DotProduct(const float* a, const float* b, int n)
+	{
+		int i = 0;
+		float sum = 0;
+#if defined(__AVX__)
+		__m256 acc = _mm256_setzero_ps();
+		for (; i + 8 <= n; i += 8)
+		{
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+		}
+		__m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+		half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+		half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+		sum = _mm_cvtss_f32(half);
+#elif defined(USE_SSE)
+		__m128 acc = _mm_setzero_ps();
+		for (; i + 4 <= n; i += 4)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+		acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+		acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+		sum = _mm_cvtss_f32(acc);
+#endif
+		for (; i < n; i++)
+		{
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+
+SimpleFir::SimpleFir(BaseSound* input, int order, waveTable* coefs)
 	{
 		this->coefs = coefs;
 		inputSig = input;
 		this->order = order;
-		for (int i = 0; i < order; i++)
+		history.assign(2 * order, 0.0f);
+	}
+
+float SimpleFir::Filter(float input)
+	{
+		float newSig = input * (*coefs)[0] + DotProduct(history.data() + historyPos, coefs->data() + 1, order);
+		if (order > 0)
 		{
-			pastInputs->push_back(0);
+			// step back one place and write both copies, so the newest output leads a contiguous window
+			historyPos = (historyPos == 0) ? order - 1 : historyPos - 1;
+			history[historyPos] = newSig;
+			history[historyPos + order] = newSig;
 		}
+		return newSig;
 	}
 
 float SimpleFir::GetSample()
 	{
-		float newSig = inputSig->GetSample() * (*coefs)[0];
-		for (int i = 0; i < order; i++)
+		return Filter(inputSig->GetSample());
+	}
+
+void SimpleFir::ProcessBlock(float* out, int frames)
+	{
+		inputSig->Process(out, frames);
+		for (int n = 0; n < frames; n++)
 		{
-			newSig += (*pastInputs)[i] * (*coefs)[i + 1]; // coefficients
+			out[n] = Filter(out[n]);
 		}
-		pastInputs->insert(pastInputs->begin(), newSig);
-
-		pastInputs->pop_back();
-		return newSig;
 	}
 
 
@@ -447,6 +1357,17 @@ float Sig::GetSample()
 		return amp;
 	}
 
+void Sig::SetParam(int param, float value)
+	{
+		(void)param;
+		amp = value;
+	}
+
+void Sig::ProcessBlock(float* out, int frames)
+	{
+		std::fill(out, out + frames, amp);
+	}
+
 
 
 float Noise::GetSample()
@@ -455,20 +1376,29 @@ float Noise::GetSample()
 	}
 
 
-void BaseSynth::AdvancePhase()
+static inline uint32_t PhaseIncrement(float freq)
 	{
-		phase += GetIncrement();
-		while (phase >= (float)table->size() - 1)
-		{
-
-			phase -= (float)table->size() - 1;
-
-		}
+		return (uint32_t)(int64_t)((double)freq / SAMPLE_RATE * 4294967296.0); // negative frequencies wrap backwards
 	}
 
-float BaseSynth::GetIncrement()
+float BaseSynth::ReadTable(const float* table, int tabSize)
 	{
-		return table->size() * freqInp->GetSample() / SAMPLE_RATE;
+		uint64_t pos = (uint64_t)phase * (uint64_t)tabSize; // table index in the top 32 bits, fraction in the bottom
+		int i = (int)(pos >> 32);
+		float frac = (float)(uint32_t)pos * (1.0f / 4294967296.0f);
+
+		if (interp == cubicInterp)
+		{
+			float xm1 = table[i - 1];
+			float x0 = table[i];
+			float x1 = table[i + 1];
+			float x2 = table[i + 2];
+			float c1 = 0.5f * (x1 - xm1);
+			float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+			float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+			return ((c3 * frac + c2) * frac + c1) * frac + x0;
+		}
+		return table[i] + (table[i + 1] - table[i]) * frac;
 	}
 
 
@@ -479,24 +1409,48 @@ void BaseSynth::Init(BaseSound* freq, BaseSound* mul, float add)
 		this->add = add;
 	}
 
+void BaseSynth::SetInterpolation(interpType interp)
+	{
+		this->interp = interp;
+	}
+
 float BaseSynth::GetSample()
 	{
-		int intPhase = (int)round(phase);
-		float samp = (*table)[intPhase];
-		AdvancePhase();
+		float freq = freqInp->GetSample();
+		const float* table = mipmap->GetLevel(mipmap->LevelFor(freq / SAMPLE_RATE));
+		float samp = ReadTable(table, mipmap->GetSize());
+		phase += PhaseIncrement(freq);
 		return samp * mulInp->GetSample() + add;
 	}
 
-
-void Saw::BuildTable(int tabSize)
+void BaseSynth::ProcessBlock(float* out, int frames)
 	{
-		float inc = 2.0f / tabSize;
-		for (int i = 0; i < tabSize; i++)
+		freqInp->Process(freqBlock, frames);
+		mulInp->Process(mulBlock, frames);
+
+		// one table for the whole block, picked for its highest frequency
+		float maxFreq = 0;
+		for (int i = 0; i < frames; i++)
+		{
+			maxFreq = std::max(maxFreq, (float)fabs(freqBlock[i]));
+		}
+		const float* table = mipmap->GetLevel(mipmap->LevelFor(maxFreq / SAMPLE_RATE));
+		int tabSize = mipmap->GetSize();
+
+		for (int i = 0; i < frames; i++)
 		{
-			(*table).push_back((inc * i - 1.0f));
+			float samp = ReadTable(table, tabSize);
+			phase += PhaseIncrement(freqBlock[i]);
+			out[i] = samp * mulBlock[i] + add;
 		}
 	}
 
+
+void Saw::BuildTable(int tabSize)
+	{
+		mipmap = WaveMipmap::Get(sawWave, tabSize);
+	}
+
 Saw::Saw(BaseSound* freq, BaseSound* mul, int tabSize, float add)
 	{
 		Init(freq, mul, add);
@@ -525,11 +1479,7 @@ Saw::Saw(float freq, float mul, int tabSize, float add)
 
 void Sine::BuildTable(int tabSize)
 	{
-		float inc = PI * 2 / tabSize;
-		for (int i = 0; i < tabSize; i++)
-		{
-			(*table).push_back(sin(inc * i));
-		}
+		mipmap = WaveMipmap::Get(sineWave, tabSize);
 	}
 
 Sine::Sine(BaseSound* freq, BaseSound* mul, int tabSize, float add)
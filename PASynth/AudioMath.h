@@ -1,23 +1,61 @@
 #pragma once
 
 #include <vector>
-typedef std::vector<float> waveTable;
+#include <cstdint>
+#include "WaveTable.h"
+#include "WorkerPool.h"
+#include "Random.h"
+
+#define MAX_BLOCK_SIZE (256) // largest block a node is asked to render at once, sizes the scratch buffers
+#define DEFAULT_MAX_GRAINS (256) // grain pool size used when a granular synth isn't given one
+#define MIN_GRAIN_RATE (0.001f) // slowest a grain steps through its source, it has to move to ever reach its finish
+#define GRAIN_PARTITIONS (16) // fixed split of the grain pool for threaded rendering, independent of the thread count
+#define MAX_CHANNELS (8) // most channels a node is asked to render at once
+#define PROB_TABLE_SIZE (4096) // steps in an SRand's table of its tight curve
+#define RAND_STREAM_SIZE (512) // values a RandStream holds, a power of two above the most grains a block can spawn
 
 class BaseSound // class to be inherited of any sound that connects a voltage
 {
+protected:
+	virtual void ProcessBlock(float* out, int frames); // frames is never more than MAX_BLOCK_SIZE, defaults to calling GetSample per frame
+	virtual void ProcessBlockChannels(float* const* out, int channels, int frames); // defaults to the mono block copied to every channel
+
 public:
 	virtual float GetSample();
+	void Process(float* out, int frames); // fill out with the next frames samples
+	void ProcessChannels(float* const* out, int channels, int frames); // fill one plane per channel, up to MAX_CHANNELS
+	virtual int GetChannels(); // channels the sound has of its own, 1 unless it plays multichannel material
+	virtual void SetParam(int param, float value); // control change between blocks, see ParamBridge. Ignored by default
 };
 
 
+/*
+Multichannel sounds map onto the channels they're asked for the same way everywhere:
+a mono request gets the average of every channel, otherwise output channel c plays channel c % GetChannels().
+*/
+
 class WavePlayer : public BaseSound
 {
 private:
-	waveTable* sourceWave;
+	const float* planes[MAX_CHANNELS]; // first sample of each channel
+	int stride = 1; // distance between a channel's samples, more than 1 for interleaved memory
+	int channels = 1;
+	int size; // in frames
 	int index = 0;
+
+	void CopyRun(int channel, float* out, int frames); // frames from index, which must not wrap
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+	void ProcessBlockChannels(float* const* out, int channels, int frames) override;
+
 public:
 	WavePlayer(waveTable* sourceWave);
+	WavePlayer(SampleBuffer* source);
+	WavePlayer(const float* samples, int frames, int channels = 1); // plays interleaved memory it doesn't own, e.g. a MappedWaveform
 	float GetSample() override;
+	int GetChannels() override;
+	void Seek(int frame); // carry on playing from frame
 };
 
 waveTable* MakeHannTable(int samples);
@@ -36,12 +74,40 @@ void AddTable(waveTable* tab, float add);
 
 void ReverseTable(waveTable* tab);
 
+float DotProduct(const float* a, const float* b, int n); // SIMD where the build allows it
+
+
+enum waveShape { sineWave, sawWave };
+
+enum interpType { linearInterp, cubicInterp };
+
+waveTable* MakeBandLimitedTable(waveShape shape, int tabSize, int harmonics); // one mipmap level, with guard samples
+
+class WaveMipmap // band-limited copies of one wave, one per octave, shared by every synth with the same shape and size
+{
+private:
+	int tabSize;
+	int harmonics; // in level 0
+	std::vector<sharedTable> levels; // level 0 holds every harmonic the table can, each level up holds half as many
+
+	WaveMipmap(waveShape shape, int tabSize);
+
+public:
+	static WaveMipmap* Get(waveShape shape, int tabSize); // built on first use, then reused
+	int GetSize();
+	int GetLevels();
+	const float* GetLevel(int level); // tabSize samples, readable from index -1 to tabSize + 1 for interpolation
+	int LevelFor(float increment); // highest level that won't alias at increment cycles per sample
+};
+
+
+enum grainParam { grainStart, grainLength, grainWait, grainRate }; // SetParam ids shared by the granular synths
 
 class Grain : public BaseSound
 {
 private:
-	waveTable* sourceWave;
-	waveTable* window;
+	SampleBuffer* source;
+	const waveTable* window;
 	int start;
 	int finish;
 	float index; // index for the soundfile
@@ -49,44 +115,80 @@ private:
 	float rate;
 	int delay;
 	bool playing;
+	float windowScale; // window samples per source sample, so the window always spans the grain
+
+	void ScaleWindow();
 
 public:
-	Grain(waveTable* sourceWave, int start, int finish, float rate, int delay, waveTable* window);
+	Grain(SampleBuffer* source, int start, int finish, float rate, int delay, const waveTable* window);
 	float GetSample() override;
 	bool IsPlaying();
 	void UpdateParams(int start, int finish, float rate, int delay);
 	void Play();
+	void Stop();
+	void AddDelay(int frames);
 	bool CheckDelay();
+	void Render(float* const* out, int channels, int* grainCount, int frames); // mix into out, counting each frame this grain sounded
 
 };
 
 
-class GranularSynth : public BaseSound 
+class GranularSynth : public BaseSound, private PoolJob
 {
 protected:
-	waveTable* sourceWave;
-	waveTable* window;
+	SampleBuffer* source;
+	sharedTable windowRef; // keeps the shared window alive
+	const waveTable* window;
 	int start;
 	int finish;
 	int wait; // Density here controls the number of samples to wait before starting a new grain
 	float rate; // For pitch alteration
 	int index = 0;
-	std::vector<Grain*>* grains = new std::vector<Grain*>();
-
-	bool oscCtrl = false;
-	float* storedParams;
 
-	virtual void NewGrain();
+	// every grain is allocated up front, so nothing is allocated on the audio thread
+	std::vector<Grain*>* grains = new std::vector<Grain*>();
+	int maxGrains = 0;
+	int* freeGrains = nullptr; // stack of pool slots that aren't playing
+	int freeCount = 0;
+	int* activeGrains = nullptr; // pool slots currently playing
+	int activeCount = 0;
+	int droppedGrains = 0; // spawns skipped because the pool was full
+
+	// opt in threaded rendering, each partition of the pool is mixed separately then summed in order
+	WorkerPool* workerPool = nullptr;
+	float* partitionMix = nullptr; // GRAIN_PARTITIONS * MAX_CHANNELS planes
+	int* partitionCount = nullptr;
+	int blockFrames = 0;
+	int blockChannels = 1;
+
+	void AllocateGrains(int maxGrains);
+	Grain* AcquireGrain();
+	void ReleaseGrain(int activeIndex);
 	virtual void RestartGrain(Grain* grain);
+	Grain* SpawnGrain(); // returns nullptr if the pool was full
+	void KeepInSource(); // clamps start and finish to the source's frames, at least a frame apart so grains can end
+	void ProcessBlock(float* out, int frames) override;
+	void ProcessBlockChannels(float* const* out, int channels, int frames) override;
+	virtual void RenderBlock(float* const* out, int channels, int frames); // both Process paths end up here
+	void RenderBlockThreaded(float* const* out, int channels, int frames);
+	void MixPartitions(float* const* out, int channels, int frames); // renders the spawned grains on the pool and sums them
+	void RunTask(int partition) override;
 	
 
 public:
-	static enum windowType { hann, somethingElse };
+	enum windowType { hann, somethingElse };
 	GranularSynth() = default;
-	GranularSynth(waveTable* sourceWave, int start, int finish, float rate, int wait, windowType wind);
+	GranularSynth(waveTable* sourceWave, int start, int finish, float rate, int wait, windowType wind, int maxGrains = DEFAULT_MAX_GRAINS);
+	GranularSynth(SampleBuffer* source, int start, int finish, float rate, int wait, windowType wind, int maxGrains = DEFAULT_MAX_GRAINS);
 	void UpdateParams(int start, int finish, int wait);
 	float GetSample() override;
-	void AddExtCtrl(float* storedParams);
+	int GetChannels() override;
+	void SetParam(int param, float value) override; // takes a grainParam
+	int GetActiveGrains();
+	int GetDroppedGrains();
+	void EnableWorkers(int threads); // threads includes the audio thread, call before starting the stream
+	int GetWorkers();
+	float GetWorkerLoad(int worker); // fraction of the last block's duration the worker spent rendering
 
 };
 
@@ -96,22 +198,53 @@ private:
 	BaseSound* startPlayer;
 	BaseSound* lengthPlayer;
 	BaseSound* densityPlayer;
+
+	void UpdateFromPlayers(float startSamp, float lengthSamp, float densitySamp);
+
+protected:
+	void RenderBlock(float* const* out, int channels, int frames) override;
 	
 
 public:
-	MovingGranularSynth(waveTable* sourceWave, BaseSound* startPlayer, BaseSound* lengthPlayer, BaseSound* densityPlayer, windowType wind);
+	MovingGranularSynth(waveTable* sourceWave, BaseSound* startPlayer, BaseSound* lengthPlayer, BaseSound* densityPlayer, windowType wind, int maxGrains = DEFAULT_MAX_GRAINS);
+	MovingGranularSynth(SampleBuffer* source, BaseSound* startPlayer, BaseSound* lengthPlayer, BaseSound* densityPlayer, windowType wind, int maxGrains = DEFAULT_MAX_GRAINS);
 	float GetSample() override;
 };
 
-class SRand //uses Dr. Mara Helmuth's prob.c
+class SRand // draws like Dr. Mara Helmuth's prob.c, from a generator each instance owns
 {
 private:
 	double low, mid, high, tight;
-	int seed = 1;
+	double range; // the wider side of mid
+	double upperReach; // how far up the uniform draw can go before landing above high
+	double lowerReach; // the same below mid, one of the two is always 1
+	Xoshiro256 generator;
+	waveTable shapeTable; // pow(u, tight) at even steps of u, empty to call pow on every draw
+
+	double Shape(double u);
+	double Place(double w); // a uniform draw over both reaches to a value
 
 public:
-	SRand(double low, double mid, double high, double tight);
+	SRand(double low, double mid, double high, double tight); // seeded from a counter, so each instance differs but runs repeat
+	SRand(double low, double mid, double high, double tight, uint64_t seed);
+	void SetSeed(uint64_t seed); // restarts the sequence
+	void EnableTable(int size = PROB_TABLE_SIZE); // interpolate pow from a table instead, before drawing on the audio thread
 	double GetVal();
+	void Fill(double* out, int n); // the next n values, the same as n calls to GetVal
+};
+
+class RandStream // an SRand's values drawn ahead in batches, so taking one on the audio thread is a couple of loads
+{
+private:
+	SRand* source;
+	double values[RAND_STREAM_SIZE]; // ring, the next value is at read
+	int read = 0;
+	int available = 0;
+
+public:
+	RandStream(SRand* source);
+	void TopUp(); // refill what has been taken, in the order the SRand would have given it
+	double Next(); // tops up first if it ran dry, so it never runs out
 };
 
 class SGranSynth : public GranularSynth
@@ -120,13 +253,17 @@ private:
 	SRand* randStart;
 	SRand* randDelay;
 	SRand* randRate;
+	RandStream* startStream; // the three SRands are only drawn from through these
+	RandStream* delayStream;
+	RandStream* rateStream;
 
 protected:
-	void NewGrain() override;
 	void RestartGrain(Grain* grain) override;
+	void RenderBlock(float* const* out, int channels, int frames) override;
 
 public:
-	SGranSynth(waveTable* sourceWave, int start, int finish, float rate, int wait, windowType wind, SRand* randStart, SRand* randDelay, SRand* randRate);
+	SGranSynth(waveTable* sourceWave, int start, int finish, float rate, int wait, windowType wind, SRand* randStart, SRand* randDelay, SRand* randRate, int maxGrains = DEFAULT_MAX_GRAINS);
+	SGranSynth(SampleBuffer* source, int start, int finish, float rate, int wait, windowType wind, SRand* randStart, SRand* randDelay, SRand* randRate, int maxGrains = DEFAULT_MAX_GRAINS);
 };
 
 
@@ -140,6 +277,9 @@ protected:
 
 class SimpleLP : public BaseSimpleFilter
 {
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
 public:
 	SimpleLP(BaseSound* input);
 
@@ -149,6 +289,9 @@ public:
 
 class SimpleHP : public BaseSimpleFilter
 {
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
 public:
 	SimpleHP(BaseSound* input);
 
@@ -159,10 +302,17 @@ public:
 class SimpleFir : public BaseSimpleFilter
 {
 private:
-	waveTable* pastInputs = new waveTable();
+	// past outputs, written twice so history[historyPos] to history[historyPos + order - 1] is always the newest first
+	waveTable history;
+	int historyPos = 0;
 	waveTable* coefs;
 	int order;
 
+	float Filter(float input);
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
 public:
 	SimpleFir(BaseSound* input, int order, waveTable* coefs);
 
@@ -173,10 +323,15 @@ public:
 class Sig : BaseSound // constant float voltage
 {
 	float amp;
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
 public:
 	Sig(float initAmp);
 
 	float GetSample() override;
+	void SetParam(int param, float value) override; // any param sets the level
 };
 
 
@@ -191,21 +346,26 @@ public:
 class BaseSynth : public BaseSound // class to be inherited
 {
 protected:
-	waveTable* table = new waveTable();
+	WaveMipmap* mipmap;
+
+	void ProcessBlock(float* out, int frames) override;
 private:
 
-	float phase = 0;
+	uint32_t phase = 0; // fixed point, a full cycle is 2^32
 	float add = 0;
+	interpType interp = linearInterp;
 	BaseSound* mulInp;
 	BaseSound* freqInp;
+	float freqBlock[MAX_BLOCK_SIZE];
+	float mulBlock[MAX_BLOCK_SIZE];
 
-	void AdvancePhase();
-
-	float GetIncrement();
+	float ReadTable(const float* table, int tabSize);
 
 public:
 	void Init(BaseSound* freq, BaseSound* mul, float add);
 
+	void SetInterpolation(interpType interp);
+
 	float GetSample() override;
 };
 
@@ -0,0 +1,391 @@
+#include <math.h>
+#include <cstring>
+#include <algorithm>
+#include "Biquad.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FILTER_LANES (8)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILTER_LANES (4)
+#else
+#define FILTER_LANES (1)
+#endif
+
+#define SAMPLE_RATE (48000)
+#define PI 3.14159265358979
+#define GLIDE_DONE (1e-4f) // coefficients this close to their targets, relative to the larger of 1 and the target, are snapped to them
+#define STATE_FLOOR (1e-15f) // about -300dB, states below it are zeroed before they decay into slow denormals
+
+
+/*
+LANE OPERATIONS
+the filter kernel runs FILTER_LANES voices at once, see GrainCloud.cpp for the same scheme
+*/
+
+#if FILTER_LANES == 8
+
+typedef __m256 LaneF;
+
+static inline LaneF LoadF(const float* p) { return _mm256_load_ps(p); }
+static inline void StoreF(float* p, LaneF v) { _mm256_store_ps(p, v); }
+static inline LaneF SetF(float f) { return _mm256_set1_ps(f); }
+static inline LaneF AddF(LaneF a, LaneF b) { return _mm256_add_ps(a, b); }
+static inline LaneF SubF(LaneF a, LaneF b) { return _mm256_sub_ps(a, b); }
+static inline LaneF MulF(LaneF a, LaneF b) { return _mm256_mul_ps(a, b); }
+
+#elif FILTER_LANES == 4
+
+typedef __m128 LaneF;
+
+static inline LaneF LoadF(const float* p) { return _mm_load_ps(p); }
+static inline void StoreF(float* p, LaneF v) { _mm_store_ps(p, v); }
+static inline LaneF SetF(float f) { return _mm_set1_ps(f); }
+static inline LaneF AddF(LaneF a, LaneF b) { return _mm_add_ps(a, b); }
+static inline LaneF SubF(LaneF a, LaneF b) { return _mm_sub_ps(a, b); }
+static inline LaneF MulF(LaneF a, LaneF b) { return _mm_mul_ps(a, b); }
+
+#else
+
+typedef float LaneF;
+
+static inline LaneF LoadF(const float* p) { return *p; }
+static inline void StoreF(float* p, LaneF v) { *p = v; }
+static inline LaneF SetF(float f) { return f; }
+static inline LaneF AddF(LaneF a, LaneF b) { return a + b; }
+static inline LaneF SubF(LaneF a, LaneF b) { return a - b; }
+static inline LaneF MulF(LaneF a, LaneF b) { return a * b; }
+
+#endif
+
+
+// runs one lane group of filters over frames frames of frame major samples, stride floats apart
+template <bool glide>
+static void RunLanes(float* const* coefs, float* const* targets, float* ic1eq, float* ic2eq,
+	float* samples, int stride, int frames, float smoothing)
+{
+	LaneF a1 = LoadF(coefs[0]);
+	LaneF a2 = LoadF(coefs[1]);
+	LaneF a3 = LoadF(coefs[2]);
+	LaneF m0 = LoadF(coefs[3]);
+	LaneF m1 = LoadF(coefs[4]);
+	LaneF m2 = LoadF(coefs[5]);
+	LaneF ic1 = LoadF(ic1eq);
+	LaneF ic2 = LoadF(ic2eq);
+
+	LaneF t1, t2, t3, tm0, tm1, tm2;
+	LaneF glideStep = SetF(smoothing);
+	if (glide)
+	{
+		t1 = LoadF(targets[0]);
+		t2 = LoadF(targets[1]);
+		t3 = LoadF(targets[2]);
+		tm0 = LoadF(targets[3]);
+		tm1 = LoadF(targets[4]);
+		tm2 = LoadF(targets[5]);
+	}
+
+	for (int f = 0; f < frames; f++)
+	{
+		if (glide)
+		{
+			a1 = AddF(a1, MulF(SubF(t1, a1), glideStep));
+			a2 = AddF(a2, MulF(SubF(t2, a2), glideStep));
+			a3 = AddF(a3, MulF(SubF(t3, a3), glideStep));
+			m0 = AddF(m0, MulF(SubF(tm0, m0), glideStep));
+			m1 = AddF(m1, MulF(SubF(tm1, m1), glideStep));
+			m2 = AddF(m2, MulF(SubF(tm2, m2), glideStep));
+		}
+
+		float* frame = samples + f * stride;
+		LaneF v0 = LoadF(frame);
+		LaneF v3 = SubF(v0, ic2);
+		LaneF v1 = AddF(MulF(a1, ic1), MulF(a2, v3));
+		LaneF v2 = AddF(ic2, AddF(MulF(a2, ic1), MulF(a3, v3)));
+		ic1 = SubF(AddF(v1, v1), ic1);
+		ic2 = SubF(AddF(v2, v2), ic2);
+		StoreF(frame, AddF(MulF(m0, v0), AddF(MulF(m1, v1), MulF(m2, v2))));
+	}
+
+	StoreF(coefs[0], a1);
+	StoreF(coefs[1], a2);
+	StoreF(coefs[2], a3);
+	StoreF(coefs[3], m0);
+	StoreF(coefs[4], m1);
+	StoreF(coefs[5], m2);
+	StoreF(ic1eq, ic1);
+	StoreF(ic2eq, ic2);
+}
+
+
+FilterCoefs MakeFilterCoefs(filterType type, float cutoff, float q, float gainDb)
+{
+	// Simper's SVF coefficients, clamped short of Nyquist where tan() blows up
+	double fc = std::min(std::max((double)cutoff, 10.0), 0.49 * SAMPLE_RATE);
+	double g = tan(PI * fc / SAMPLE_RATE);
+	double k = 1.0 / std::max((double)q, 0.01);
+	double a = pow(10.0, gainDb / 40.0); // amplitude at the shelf or peak is a * a
+
+	double m0 = 0;
+	double m1 = 0;
+	double m2 = 0;
+	switch (type)
+	{
+	case lowPassFilter:
+		m2 = 1;
+		break;
+	case highPassFilter:
+		m0 = 1;
+		m1 = -k;
+		m2 = -1;
+		break;
+	case bandPassFilter: // 0dB at the centre
+		m1 = k;
+		break;
+	case notchFilter:
+		m0 = 1;
+		m1 = -k;
+		break;
+	case lowShelfFilter:
+		g /= sqrt(a);
+		m0 = 1;
+		m1 = k * (a - 1);
+		m2 = a * a - 1;
+		break;
+	case highShelfFilter:
+		g *= sqrt(a);
+		m0 = a * a;
+		m1 = k * (1 - a) * a;
+		m2 = 1 - a * a;
+		break;
+	case peakFilter:
+		k /= a;
+		m0 = 1;
+		m1 = k * (a * a - 1);
+		break;
+	}
+
+	FilterCoefs filter;
+	double a1 = 1.0 / (1.0 + g * (g + k));
+	filter.a1 = (float)a1;
+	filter.a2 = (float)(g * a1);
+	filter.a3 = (float)(g * g * a1);
+	filter.m0 = (float)m0;
+	filter.m1 = (float)m1;
+	filter.m2 = (float)m2;
+	return filter;
+}
+
+
+/*
+FILTER BANK
+*/
+
+BiquadBank::BiquadBank(int voices, float glideSeconds)
+{
+	this->voices = (voices + FILTER_LANES - 1) / FILTER_LANES * FILTER_LANES;
+	smoothing = (glideSeconds > 0) ? 1.0f - expf(-1.0f / (glideSeconds * SAMPLE_RATE)) : 1.0f;
+
+	// waveTables start TABLE_ALIGN aligned, enough for the lane loads
+	for (int c = 0; c < 6; c++)
+	{
+		coefs[c].resize(this->voices);
+		targets[c].resize(this->voices);
+	}
+	ic1eq.resize(this->voices);
+	ic2eq.resize(this->voices);
+	frameMajor.resize(MAX_BLOCK_SIZE * this->voices);
+
+	// every voice starts out passing its input straight through
+	FilterCoefs through = MakeFilterCoefs(lowPassFilter, 1000.0f, DEFAULT_FILTER_Q, 0);
+	through.m0 = 1;
+	through.m1 = 0;
+	through.m2 = 0;
+	for (int v = 0; v < this->voices; v++)
+	{
+		SetFilter(v, through, false);
+	}
+	Reset();
+}
+
+void BiquadBank::SetFilter(int voice, const FilterCoefs& filter, bool glide)
+{
+	const float values[6] = { filter.a1, filter.a2, filter.a3, filter.m0, filter.m1, filter.m2 };
+	for (int c = 0; c < 6; c++)
+	{
+		targets[c][voice] = values[c];
+		if (!glide)
+		{
+			coefs[c][voice] = values[c];
+		}
+	}
+}
+
+void BiquadBank::SetFilter(int voice, filterType type, float cutoff, float q, float gainDb)
+{
+	SetFilter(voice, MakeFilterCoefs(type, cutoff, q, gainDb));
+}
+
+void BiquadBank::Reset()
+{
+	std::fill(ic1eq.begin(), ic1eq.end(), 0.0f);
+	std::fill(ic2eq.begin(), ic2eq.end(), 0.0f);
+}
+
+void BiquadBank::Process(float* const* planes, int count, int frames)
+{
+	count = std::max(0, std::min(count, voices)); // planes past the bank's voices are left as they are
+	frames = std::max(0, std::min(frames, MAX_BLOCK_SIZE));
+	int groups = (count + FILTER_LANES - 1) / FILTER_LANES;
+	int width = groups * FILTER_LANES;
+
+	for (int f = 0; f < frames; f++)
+	{
+		float* frame = frameMajor.data() + f * width;
+		for (int v = 0; v < count; v++)
+		{
+			frame[v] = planes[v][f];
+		}
+		for (int v = count; v < width; v++)
+		{
+			frame[v] = 0.0f;
+		}
+	}
+
+	for (int g = 0; g < groups; g++)
+	{
+		int first = g * FILTER_LANES;
+		float* groupCoefs[6];
+		float* groupTargets[6];
+		bool gliding = false;
+		for (int c = 0; c < 6; c++)
+		{
+			groupCoefs[c] = coefs[c].data() + first;
+			groupTargets[c] = targets[c].data() + first;
+			for (int l = 0; l < FILTER_LANES; l++)
+			{
+				// a float glide can stall just short of its target, and one heading for 0 ends in denormals, so stop well before
+				float target = groupTargets[c][l];
+				gliding = gliding || fabsf(target - groupCoefs[c][l]) > GLIDE_DONE * std::max(1.0f, fabsf(target));
+			}
+		}
+
+		if (gliding)
+		{
+			RunLanes<true>(groupCoefs, groupTargets, ic1eq.data() + first, ic2eq.data() + first, frameMajor.data() + first, width, frames, smoothing);
+		}
+		else
+		{
+			// settled, snap the last bit of glide and skip the per sample coefficient updates
+			for (int c = 0; c < 6; c++)
+			{
+				std::copy(groupTargets[c], groupTargets[c] + FILTER_LANES, groupCoefs[c]);
+			}
+			RunLanes<false>(groupCoefs, groupTargets, ic1eq.data() + first, ic2eq.data() + first, frameMajor.data() + first, width, frames, smoothing);
+		}
+	}
+
+	for (int v = 0; v < width; v++)
+	{
+		if (fabsf(ic1eq[v]) < STATE_FLOOR)
+		{
+			ic1eq[v] = 0.0f;
+		}
+		if (fabsf(ic2eq[v]) < STATE_FLOOR)
+		{
+			ic2eq[v] = 0.0f;
+		}
+	}
+
+	for (int f = 0; f < frames; f++)
+	{
+		const float* frame = frameMajor.data() + f * width;
+		for (int v = 0; v < count; v++)
+		{
+			planes[v][f] = frame[v];
+		}
+	}
+}
+
+
+/*
+FILTER NODE
+*/
+
+BiquadFilter::BiquadFilter(BaseSound* input, filterType type, float cutoff, float q, float gainDb)
+{
+	inputSig = input;
+	bank = new BiquadBank(MAX_CHANNELS);
+	this->type = type;
+	this->cutoff = cutoff;
+	this->q = q;
+	this->gainDb = gainDb;
+	FilterCoefs filter = MakeFilterCoefs(type, cutoff, q, gainDb);
+	for (int c = 0; c < MAX_CHANNELS; c++)
+	{
+		bank->SetFilter(c, filter, false); // start on the setting rather than gliding in from nothing
+	}
+}
+
+void BiquadFilter::Update()
+{
+	FilterCoefs filter = MakeFilterCoefs(type, cutoff, q, gainDb);
+	for (int c = 0; c < MAX_CHANNELS; c++)
+	{
+		bank->SetFilter(c, filter);
+	}
+}
+
+void BiquadFilter::SetFilter(filterType type, float cutoff, float q, float gainDb)
+{
+	this->type = type;
+	this->cutoff = cutoff;
+	this->q = q;
+	this->gainDb = gainDb;
+	Update();
+}
+
+void BiquadFilter::SetParam(int param, float value)
+{
+	switch (param)
+	{
+	case filterCutoff:
+		cutoff = value;
+		break;
+	case filterQ:
+		q = value;
+		break;
+	case filterGain:
+		gainDb = value;
+		break;
+	default:
+		return;
+	}
+	Update();
+}
+
+int BiquadFilter::GetChannels()
+{
+	return inputSig->GetChannels();
+}
+
+float BiquadFilter::GetSample()
+{
+	float samp = inputSig->GetSample();
+	float* plane = &samp;
+	bank->Process(&plane, 1, 1);
+	return samp;
+}
+
+void BiquadFilter::ProcessBlock(float* out, int frames)
+{
+	inputSig->Process(out, frames);
+	bank->Process(&out, 1, frames);
+}
+
+void BiquadFilter::ProcessBlockChannels(float* const* out, int channels, int frames)
+{
+	inputSig->ProcessChannels(out, channels, frames);
+	bank->Process(out, channels, frames);
+}
\ No newline at end of file
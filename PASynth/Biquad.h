@@ -0,0 +1,66 @@
+#pragma once
+
+#include "AudioMath.h"
+
+#define DEFAULT_FILTER_Q (0.7071f) // Butterworth, no resonant bump
+#define DEFAULT_FILTER_GLIDE (0.005f) // seconds for a coefficient change to mostly settle
+
+enum filterType { lowPassFilter, highPassFilter, bandPassFilter, notchFilter, lowShelfFilter, highShelfFilter, peakFilter };
+
+enum filterParam { filterCutoff, filterQ, filterGain }; // SetParam ids for BiquadFilter
+
+struct FilterCoefs
+{
+	float a1, a2, a3; // the two integrators' response, set by cutoff and Q
+	float m0, m1, m2; // how much of the input, band and low outputs make up the filter type
+};
+
+FilterCoefs MakeFilterCoefs(filterType type, float cutoff, float q, float gainDb); // gainDb only matters for shelves and peaks
+
+/*
+State variable filters in Andrew Simper's trapezoidal form, which covers every biquad response
+and stays stable while its coefficients move, for any number of voices at once.
+Each coefficient and state is an array with a slot per voice, so a block runs FILTER_LANES voices
+through SIMD registers together. New settings are glided to a sample at a time, so sweeps don't click.
+*/
+class BiquadBank
+{
+private:
+	int voices; // rounded up to whole lane groups
+	float smoothing; // fraction of the way to the target coefficients moved each sample
+	waveTable coefs[6]; // a1, a2, a3, m0, m1, m2, voices floats each
+	waveTable targets[6];
+	waveTable ic1eq; // integrator states
+	waveTable ic2eq;
+	waveTable frameMajor; // a block transposed so each frame's voices sit together
+
+public:
+	BiquadBank(int voices, float glideSeconds = DEFAULT_FILTER_GLIDE);
+	void SetFilter(int voice, const FilterCoefs& filter, bool glide = true);
+	void SetFilter(int voice, filterType type, float cutoff, float q = DEFAULT_FILTER_Q, float gainDb = 0);
+	void Process(float* const* planes, int count, int frames); // filters the first count voices in place, one plane each, at most MAX_BLOCK_SIZE frames
+	void Reset(); // silences the filters' memory
+};
+
+class BiquadFilter : public BaseSimpleFilter // a BiquadBank with a voice per channel of its input
+{
+private:
+	BiquadBank* bank;
+	filterType type;
+	float cutoff;
+	float q;
+	float gainDb;
+
+	void Update();
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+	void ProcessBlockChannels(float* const* out, int channels, int frames) override;
+
+public:
+	BiquadFilter(BaseSound* input, filterType type, float cutoff, float q = DEFAULT_FILTER_Q, float gainDb = 0);
+	float GetSample() override;
+	int GetChannels() override; // the input's
+	void SetFilter(filterType type, float cutoff, float q = DEFAULT_FILTER_Q, float gainDb = 0); // glides to the new setting
+	void SetParam(int param, float value) override; // takes a filterParam
+};
\ No newline at end of file
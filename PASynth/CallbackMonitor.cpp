@@ -0,0 +1,120 @@
+#include "portaudio.h"
+#include "CallbackMonitor.h"
+
+// the only writer bumps its own counters, a relaxed load and store avoids a locked add
+static void Increment(std::atomic<long long>& counter, long long amount = 1)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+CallbackMonitor::CallbackMonitor(double sampleRate)
+{
+	nsPerFrame = 1e9 / sampleRate;
+	seq = 0;
+	callbacks = 0;
+	overruns = 0;
+	outputUnderflows = 0;
+	outputOverflows = 0;
+	primingCallbacks = 0;
+	lastNs = 0;
+	maxNs = 0;
+	totalNs = 0;
+	deadlineNs = 0;
+	for (int b = 0; b < LOAD_BUCKETS; b++)
+	{
+		loadHistogram[b] = 0;
+	}
+}
+
+void CallbackMonitor::Begin()
+{
+	callbackStart = std::chrono::steady_clock::now();
+}
+
+void CallbackMonitor::End(unsigned long frames, unsigned long statusFlags)
+{
+	long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - callbackStart).count();
+	long long deadline = (long long)(frames * nsPerFrame);
+
+	int bucket;
+	if (ns < deadline)
+	{
+		bucket = (deadline > 0) ? (int)(ns * 10 / deadline) : 0;
+	}
+	else
+	{
+		bucket = (ns * 2 < deadline * 3) ? LOAD_BUCKETS - 2 : LOAD_BUCKETS - 1;
+	}
+
+	unsigned s = seq.load(std::memory_order_relaxed);
+	seq.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Increment(callbacks);
+	if (bucket >= LOAD_BUCKETS - 2)
+	{
+		Increment(overruns);
+	}
+	if (statusFlags & paOutputUnderflow)
+	{
+		Increment(outputUnderflows);
+	}
+	if (statusFlags & paOutputOverflow)
+	{
+		Increment(outputOverflows);
+	}
+	if (statusFlags & paPrimingOutput)
+	{
+		Increment(primingCallbacks);
+	}
+	lastNs.store(ns, std::memory_order_relaxed);
+	if (ns > maxNs.load(std::memory_order_relaxed))
+	{
+		maxNs.store(ns, std::memory_order_relaxed);
+	}
+	Increment(totalNs, ns);
+	deadlineNs.store(deadline, std::memory_order_relaxed);
+	Increment(loadHistogram[bucket]);
+
+	seq.store(s + 2, std::memory_order_release);
+}
+
+CallbackStats CallbackMonitor::GetStats()
+{
+	CallbackStats stats;
+	long long total;
+	unsigned before;
+	unsigned after;
+	do
+	{
+		before = seq.load(std::memory_order_acquire);
+		stats.callbacks = callbacks.load(std::memory_order_relaxed);
+		stats.overruns = overruns.load(std::memory_order_relaxed);
+		stats.outputUnderflows = outputUnderflows.load(std::memory_order_relaxed);
+		stats.outputOverflows = outputOverflows.load(std::memory_order_relaxed);
+		stats.primingCallbacks = primingCallbacks.load(std::memory_order_relaxed);
+		stats.lastMs = lastNs.load(std::memory_order_relaxed) / 1e6;
+		stats.maxMs = maxNs.load(std::memory_order_relaxed) / 1e6;
+		total = totalNs.load(std::memory_order_relaxed);
+		stats.deadlineMs = deadlineNs.load(std::memory_order_relaxed) / 1e6;
+		for (int b = 0; b < LOAD_BUCKETS; b++)
+		{
+			stats.loadHistogram[b] = loadHistogram[b].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = seq.load(std::memory_order_relaxed);
+	} while ((before & 1) || before != after);
+
+	stats.meanMs = (stats.callbacks > 0) ? total / 1e6 / stats.callbacks : 0.0;
+	return stats;
+}
+
+double CallbackMonitor::BucketLimit(int bucket)
+{
+	if (bucket < LOAD_BUCKETS - 2)
+	{
+		return (bucket + 1) / 10.0;
+	}
+	return (bucket == LOAD_BUCKETS - 2) ? 1.5 : 1e300;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#define LOAD_BUCKETS (12) // a tenth of the deadline each up to 100%, then 100-150% and anything slower
+
+struct CallbackStats
+{
+	long long callbacks;
+	long long overruns; // callbacks that took longer than the audio they rendered
+	long long outputUnderflows; // xruns PortAudio reported through statusFlags
+	long long outputOverflows;
+	long long primingCallbacks; // output PortAudio generated before the stream started
+	double lastMs;
+	double maxMs;
+	double meanMs;
+	double deadlineMs; // duration of the audio the last callback rendered
+	long long loadHistogram[LOAD_BUCKETS]; // callbacks by their duration over their deadline
+};
+
+/*
+Times every audio callback against the audio it renders and counts the xruns PortAudio reports.
+Only the audio thread writes, with plain stores and no locked instructions.
+Any other thread can take a consistent copy with GetStats, retrying if a callback finished mid copy.
+*/
+class CallbackMonitor
+{
+private:
+	double nsPerFrame;
+	std::chrono::steady_clock::time_point callbackStart;
+
+	std::atomic<unsigned> seq; // odd while the audio thread is updating
+	std::atomic<long long> callbacks;
+	std::atomic<long long> overruns;
+	std::atomic<long long> outputUnderflows;
+	std::atomic<long long> outputOverflows;
+	std::atomic<long long> primingCallbacks;
+	std::atomic<long long> lastNs;
+	std::atomic<long long> maxNs;
+	std::atomic<long long> totalNs;
+	std::atomic<long long> deadlineNs;
+	std::atomic<long long> loadHistogram[LOAD_BUCKETS];
+
+public:
+	CallbackMonitor(double sampleRate);
+
+	// audio thread
+	void Begin(); // first thing in the callback
+	void End(unsigned long frames, unsigned long statusFlags); // last thing, with the callback's frame count and flags
+
+	CallbackStats GetStats(); // any thread
+	static double BucketLimit(int bucket); // upper edge of a histogram bucket as a fraction of the deadline
+};
\ No newline at end of file
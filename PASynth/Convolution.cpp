@@ -0,0 +1,133 @@
+#include <algorithm>
+#include "Convolution.h"
+
+ConvolutionFilter::ConvolutionFilter(BaseSound* input, waveTable* coefs, int partitionSize)
+{
+	inputSig = input;
+	this->partitionSize = 1;
+	while (this->partitionSize < partitionSize) // the FFT is radix 2, so round up to the next power of two
+	{
+		this->partitionSize *= 2;
+	}
+	partitionSize = this->partitionSize;
+	int taps = (int)coefs->size();
+	int fftSize = 2 * partitionSize;
+	fft = new FFT(fftSize);
+	bins = partitionSize + 1;
+
+	int headLength = std::min(taps, partitionSize);
+	headTaps.assign(coefs->begin(), coefs->begin() + headLength);
+	history.assign(2 * headLength, 0.0f);
+
+	partitions = (taps > partitionSize) ? (taps - 1) / partitionSize : 0;
+	tailRe.assign(partitions * bins, 0.0f);
+	tailIm.assign(partitions * bins, 0.0f);
+	inputRe.assign(partitions * bins, 0.0f);
+	inputIm.assign(partitions * bins, 0.0f);
+	workRe.assign(fftSize, 0.0f);
+	workIm.assign(fftSize, 0.0f);
+	blockInput.assign(fftSize, 0.0f);
+	tailOutput.assign(partitionSize, 0.0f);
+
+	// zero padded spectrum of each tail partition
+	for (int p = 0; p < partitions; p++)
+	{
+		std::fill(workRe.begin(), workRe.end(), 0.0f);
+		std::fill(workIm.begin(), workIm.end(), 0.0f);
+		int first = (p + 1) * partitionSize;
+		int count = std::min(partitionSize, taps - first);
+		std::copy(coefs->begin() + first, coefs->begin() + first + count, workRe.begin());
+		fft->Forward(workRe.data(), workIm.data());
+		std::copy(workRe.begin(), workRe.begin() + bins, tailRe.begin() + p * bins);
+		std::copy(workIm.begin(), workIm.begin() + bins, tailIm.begin() + p * bins);
+	}
+}
+
+void ConvolutionFilter::FinishBlock()
+{
+	int fftSize = 2 * partitionSize;
+
+	// spectrum of the last two blocks, kept with the older ones
+	std::copy(blockInput.begin(), blockInput.end(), workRe.begin());
+	std::fill(workIm.begin(), workIm.end(), 0.0f);
+	fft->Forward(workRe.data(), workIm.data());
+	newestSpectrum = (newestSpectrum + 1) % partitions;
+	std::copy(workRe.begin(), workRe.begin() + bins, inputRe.begin() + newestSpectrum * bins);
+	std::copy(workIm.begin(), workIm.begin() + bins, inputIm.begin() + newestSpectrum * bins);
+
+	// tail partition p, delayed p + 1 blocks, meets the input block that many blocks old
+	std::fill(workRe.begin(), workRe.end(), 0.0f);
+	std::fill(workIm.begin(), workIm.end(), 0.0f);
+	for (int p = 0; p < partitions; p++)
+	{
+		int spectrum = (newestSpectrum - p + partitions) % partitions;
+		const float* xr = inputRe.data() + spectrum * bins;
+		const float* xi = inputIm.data() + spectrum * bins;
+		const float* hr = tailRe.data() + p * bins;
+		const float* hi = tailIm.data() + p * bins;
+		float* yr = workRe.data();
+		float* yi = workIm.data();
+		for (int k = 0; k < bins; k++)
+		{
+			yr[k] += xr[k] * hr[k] - xi[k] * hi[k];
+			yi[k] += xr[k] * hi[k] + xi[k] * hr[k];
+		}
+	}
+
+	// the output is real, so the upper half of the spectrum mirrors the lower
+	for (int k = 1; k < partitionSize; k++)
+	{
+		workRe[fftSize - k] = workRe[k];
+		workIm[fftSize - k] = -workIm[k];
+	}
+	fft->Inverse(workRe.data(), workIm.data());
+
+	// overlap-save keeps only the second half
+	float scale = 1.0f / fftSize;
+	for (int i = 0; i < partitionSize; i++)
+	{
+		tailOutput[i] = workRe[partitionSize + i] * scale;
+	}
+
+	std::copy(blockInput.begin() + partitionSize, blockInput.end(), blockInput.begin());
+}
+
+float ConvolutionFilter::Filter(float input)
+{
+	int headLength = (int)headTaps.size();
+	if (headLength == 0)
+	{
+		return 0.0f;
+	}
+	historyPos = (historyPos == 0) ? headLength - 1 : historyPos - 1;
+	history[historyPos] = input;
+	history[historyPos + headLength] = input;
+	float out = DotProduct(history.data() + historyPos, headTaps.data(), headLength);
+
+	if (partitions > 0)
+	{
+		out += tailOutput[blockPos];
+		blockInput[partitionSize + blockPos] = input;
+		blockPos++;
+		if (blockPos == partitionSize)
+		{
+			FinishBlock();
+			blockPos = 0;
+		}
+	}
+	return out;
+}
+
+float ConvolutionFilter::GetSample()
+{
+	return Filter(inputSig->GetSample());
+}
+
+void ConvolutionFilter::ProcessBlock(float* out, int frames)
+{
+	inputSig->Process(out, frames);
+	for (int n = 0; n < frames; n++)
+	{
+		out[n] = Filter(out[n]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "AudioMath.h"
+#include "FFT.h"
+
+/*
+Uniformly partitioned overlap-save convolution, for impulse responses too long for SimpleFir.
+The first partitionSize taps are applied directly so the output has no added latency,
+the rest are applied a partition at a time in the frequency domain once per partitionSize samples.
+*/
+
+class ConvolutionFilter : public BaseSimpleFilter
+{
+private:
+	int partitionSize;
+	int partitions; // frequency domain partitions after the direct head
+	int bins; // unique bins in each 2 * partitionSize point spectrum
+	FFT* fft;
+
+	waveTable headTaps;
+	waveTable history; // past inputs written twice, see SimpleFir
+	int historyPos = 0;
+
+	std::vector<float> tailRe; // spectrum of each tail partition, partitions * bins
+	std::vector<float> tailIm;
+	std::vector<float> inputRe; // spectra of the last partitions input blocks
+	std::vector<float> inputIm;
+	int newestSpectrum = 0;
+
+	waveTable blockInput; // the previous input block followed by the one being filled
+	waveTable tailOutput; // what the tail partitions add to the block being filled
+	int blockPos = 0;
+	std::vector<float> workRe;
+	std::vector<float> workIm;
+
+	float Filter(float input);
+	void FinishBlock();
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
+public:
+	ConvolutionFilter(BaseSound* input, waveTable* coefs, int partitionSize = 64); // partitionSize is rounded up to a power of two
+	float GetSample() override;
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include <math.h>
+#include <utility>
+#include "FFT.h"
+
+FFT::FFT(int size)
+{
+	this->size = size;
+
+	int bits = 0;
+	while ((1 << bits) < size)
+	{
+		bits++;
+	}
+	bitReverse.resize(size);
+	for (int i = 0; i < size; i++)
+	{
+		int r = 0;
+		for (int b = 0; b < bits; b++)
+		{
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		bitReverse[i] = r;
+	}
+
+	cosTable.resize(size / 2);
+	sinTable.resize(size / 2);
+	for (int i = 0; i < size / 2; i++)
+	{
+		double angle = 2.0 * 3.14159265358979323846 * i / size;
+		cosTable[i] = (float)cos(angle);
+		sinTable[i] = (float)sin(angle);
+	}
+}
+
+int FFT::GetSize()
+{
+	return size;
+}
+
+void FFT::Transform(float* re, float* im, float direction)
+{
+	for (int i = 0; i < size; i++)
+	{
+		int r = bitReverse[i];
+		if (r > i)
+		{
+			std::swap(re[i], re[r]);
+			std::swap(im[i], im[r]);
+		}
+	}
+
+	for (int span = 1; span < size; span *= 2)
+	{
+		int step = size / (2 * span); // stride through the twiddle tables at this stage
+		for (int group = 0; group < size; group += 2 * span)
+		{
+			for (int k = 0; k < span; k++)
+			{
+				float wr = cosTable[k * step];
+				float wi = direction * sinTable[k * step];
+				int a = group + k;
+				int b = a + span;
+				float tr = re[b] * wr - im[b] * wi;
+				float ti = re[b] * wi + im[b] * wr;
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+void FFT::Forward(float* re, float* im)
+{
+	Transform(re, im, -1.0f);
+}
+
+void FFT::Inverse(float* re, float* im)
+{
+	Transform(re, im, 1.0f);
+}
\ No newline at end of file
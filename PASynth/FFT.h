@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+class FFT // in place radix-2 complex FFT on split real and imaginary arrays
+{
+private:
+	int size;
+	std::vector<int> bitReverse;
+	std::vector<float> cosTable;
+	std::vector<float> sinTable;
+
+	void Transform(float* re, float* im, float direction);
+
+public:
+	FFT(int size); // size must be a power of two
+	int GetSize();
+	void Forward(float* re, float* im);
+	void Inverse(float* re, float* im); // unscaled, divide by size to undo Forward
+};
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include <math.h>
+#include <cstring>
+#include <algorithm>
+#include "GrainCloud.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GRAIN_LANES (8)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GRAIN_LANES (4)
+#else
+#define GRAIN_LANES (1)
+#endif
+
+
+/*
+LANE OPERATIONS
+each kernel works on GRAIN_LANES grains at once, masks are all ones in lanes that are sounding
+*/
+
+#if GRAIN_LANES == 8
+
+typedef __m256 LaneF;
+typedef __m256i LaneI;
+
+static inline LaneF LoadF(const float* p) { return _mm256_load_ps(p); }
+static inline void StoreF(float* p, LaneF v) { _mm256_store_ps(p, v); }
+static inline LaneI LoadI(const int* p) { return _mm256_load_si256((const __m256i*)p); }
+static inline void StoreI(int* p, LaneI v) { _mm256_store_si256((__m256i*)p, v); }
+static inline LaneF SetF(float f) { return _mm256_set1_ps(f); }
+static inline LaneF AddF(LaneF a, LaneF b) { return _mm256_add_ps(a, b); }
+static inline LaneF MulF(LaneF a, LaneF b) { return _mm256_mul_ps(a, b); }
+static inline LaneF MinF(LaneF a, LaneF b) { return _mm256_min_ps(a, b); }
+static inline LaneF MaskF(LaneI mask, LaneF v) { return _mm256_and_ps(_mm256_castsi256_ps(mask), v); }
+static inline LaneI AddI(LaneI a, LaneI b) { return _mm256_add_epi32(a, b); }
+static inline LaneI AndNotI(LaneI a, LaneI b) { return _mm256_andnot_si256(a, b); }
+static inline LaneI AndI(LaneI a, LaneI b) { return _mm256_and_si256(a, b); }
+static inline LaneI Positive(LaneI a) { return _mm256_cmpgt_epi32(a, _mm256_setzero_si256()); }
+static inline LaneI Truncate(LaneF v) { return _mm256_cvttps_epi32(v); }
+static inline LaneF Gather(const float* table, LaneI index) { return _mm256_i32gather_ps(table, index, 4); }
+
+#elif GRAIN_LANES == 4
+
+typedef __m128 LaneF;
+typedef __m128i LaneI;
+
+static inline LaneF LoadF(const float* p) { return _mm_load_ps(p); }
+static inline void StoreF(float* p, LaneF v) { _mm_store_ps(p, v); }
+static inline LaneI LoadI(const int* p) { return _mm_load_si128((const __m128i*)p); }
+static inline void StoreI(int* p, LaneI v) { _mm_store_si128((__m128i*)p, v); }
+static inline LaneF SetF(float f) { return _mm_set1_ps(f); }
+static inline LaneF AddF(LaneF a, LaneF b) { return _mm_add_ps(a, b); }
+static inline LaneF MulF(LaneF a, LaneF b) { return _mm_mul_ps(a, b); }
+static inline LaneF MinF(LaneF a, LaneF b) { return _mm_min_ps(a, b); }
+static inline LaneF MaskF(LaneI mask, LaneF v) { return _mm_and_ps(_mm_castsi128_ps(mask), v); }
+static inline LaneI AddI(LaneI a, LaneI b) { return _mm_add_epi32(a, b); }
+static inline LaneI AndNotI(LaneI a, LaneI b) { return _mm_andnot_si128(a, b); }
+static inline LaneI AndI(LaneI a, LaneI b) { return _mm_and_si128(a, b); }
+static inline LaneI Positive(LaneI a) { return _mm_cmpgt_epi32(a, _mm_setzero_si128()); }
+static inline LaneI Truncate(LaneF v) { return _mm_cvttps_epi32(v); }
+static inline LaneF Gather(const float* table, LaneI index) // SSE2 has no gather instruction
+{
+	alignas(16) int i[4];
+	_mm_store_si128((__m128i*)i, index);
+	return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+#else
+
+typedef float LaneF;
+typedef int LaneI;
+
+static inline LaneF LoadF(const float* p) { return *p; }
+static inline void StoreF(float* p, LaneF v) { *p = v; }
+static inline LaneI LoadI(const int* p) { return *p; }
+static inline void StoreI(int* p, LaneI v) { *p = v; }
+static inline LaneF SetF(float f) { return f; }
+static inline LaneF AddF(LaneF a, LaneF b) { return a + b; }
+static inline LaneF MulF(LaneF a, LaneF b) { return a * b; }
+static inline LaneF MinF(LaneF a, LaneF b) { return std::min(a, b); }
+static inline LaneF MaskF(LaneI mask, LaneF v) { return mask ? v : 0.0f; }
+static inline LaneI AddI(LaneI a, LaneI b) { return a + b; }
+static inline LaneI AndNotI(LaneI a, LaneI b) { return ~a & b; }
+static inline LaneI AndI(LaneI a, LaneI b) { return a & b; }
+static inline LaneI Positive(LaneI a) { return (a > 0) ? -1 : 0; }
+static inline LaneI Truncate(LaneF v) { return (int)v; }
+static inline LaneF Gather(const float* table, LaneI index) { return table[index]; }
+
+#endif
+
+
+// mixes one lane group of grains into the per lane accumulators for frames frames
+static void RenderLanes(const float* source, const float* window, float lastWindowIndex,
+	float* positions, const float* steps, float* windowPhases, const float* windowSteps,
+	int* remaining, int* delays, float* mixLanes, float* countLanes, int frames)
+{
+	LaneF pos = LoadF(positions);
+	LaneF step = LoadF(steps);
+	LaneF phase = LoadF(windowPhases);
+	LaneF phaseStep = LoadF(windowSteps);
+	LaneI left = LoadI(remaining);
+	LaneI delay = LoadI(delays);
+	LaneF one = SetF(1.0f);
+	LaneF lastWindow = SetF(lastWindowIndex);
+
+	for (int f = 0; f < frames; f++)
+	{
+		LaneI waiting = Positive(delay);
+		LaneI sounding = AndNotI(waiting, Positive(left));
+
+		// silent lanes read index 0 so their stale positions never leave the tables
+		LaneI sourceIndex = AndI(sounding, Truncate(pos));
+		LaneI windowIndex = AndI(sounding, Truncate(MinF(phase, lastWindow)));
+		LaneF samp = MulF(Gather(source, sourceIndex), Gather(window, windowIndex));
+
+		float* mix = mixLanes + f * GRAIN_LANES;
+		float* count = countLanes + f * GRAIN_LANES;
+		StoreF(mix, AddF(LoadF(mix), MaskF(sounding, samp)));
+		StoreF(count, AddF(LoadF(count), MaskF(sounding, one)));
+
+		pos = AddF(pos, MaskF(sounding, step));
+		phase = AddF(phase, MaskF(sounding, phaseStep));
+		left = AddI(left, sounding); // masks are -1, so adding them counts down
+		delay = AddI(delay, waiting);
+	}
+
+	StoreF(positions, pos);
+	StoreF(windowPhases, phase);
+	StoreI(remaining, left);
+	StoreI(delays, delay);
+}
+
+
+
+GrainCloud::GrainCloud(waveTable* sourceWave, int start, int finish, float rate, int wait, int maxGrains)
+{
+	this->sourceWave = sourceWave;
+	this->windowRef = GetSharedTable(hannTable, abs(finish - start));
+	this->window = windowRef.get();
+	this->start = start;
+	this->finish = finish;
+	this->rate = rate;
+	this->wait = wait;
+	this->maxGrains = (maxGrains + GRAIN_LANES - 1) / GRAIN_LANES * GRAIN_LANES;
+
+	// all zeroed and TABLE_ALIGN aligned, which covers the widest lane loads
+	int lanes = this->maxGrains;
+	positions.assign(lanes, 0.0f);
+	steps.assign(lanes, 0.0f);
+	windowPhases.assign(lanes, 0.0f);
+	windowSteps.assign(lanes, 0.0f);
+	remaining.assign(lanes, 0);
+	delays.assign(lanes, 0);
+
+	mixLanes.assign(MAX_BLOCK_SIZE * GRAIN_LANES, 0.0f);
+	countLanes.assign(MAX_BLOCK_SIZE * GRAIN_LANES, 0.0f);
+}
+
+void GrainCloud::SpawnGrain(int onset)
+{
+	index = 0;
+	int length = abs(finish - start);
+	if (activeCount == maxGrains || length == 0 || rate <= 0)
+	{
+		droppedGrains++;
+		return;
+	}
+
+	int g = activeCount++;
+	positions[g] = (float)start;
+	steps[g] = (finish > start) ? rate : -rate;
+	windowPhases[g] = 0;
+	windowSteps[g] = rate * (float)window->size() / length; // stretch the window over any grain length
+	remaining[g] = (int)ceil(length / rate);
+	delays[g] = onset;
+}
+
+void GrainCloud::RemoveFinishedGrains()
+{
+	for (int g = 0; g < activeCount;)
+	{
+		if (remaining[g] > 0 || delays[g] > 0)
+		{
+			g++;
+			continue;
+		}
+
+		// move the last grain into the hole and silence its old lane
+		int last = --activeCount;
+		positions[g] = positions[last];
+		steps[g] = steps[last];
+		windowPhases[g] = windowPhases[last];
+		windowSteps[g] = windowSteps[last];
+		remaining[g] = remaining[last];
+		delays[g] = delays[last];
+
+		positions[last] = 0;
+		windowPhases[last] = 0;
+		remaining[last] = 0;
+		delays[last] = 0;
+	}
+}
+
+void GrainCloud::RenderBlock(int frames)
+{
+	const float* source = sourceWave->data();
+	const float* windowData = window->data();
+	float lastWindowIndex = (float)window->size() - 1;
+
+	for (int g = 0; g < activeCount; g += GRAIN_LANES)
+	{
+		RenderLanes(source, windowData, lastWindowIndex,
+			&positions[g], &steps[g], &windowPhases[g], &windowSteps[g],
+			&remaining[g], &delays[g], mixLanes.data(), countLanes.data(), frames);
+	}
+	RemoveFinishedGrains();
+}
+
+void GrainCloud::ProcessBlock(float* out, int frames)
+{
+	std::fill(mixLanes.begin(), mixLanes.begin() + frames * GRAIN_LANES, 0.0f);
+	std::fill(countLanes.begin(), countLanes.begin() + frames * GRAIN_LANES, 0.0f);
+
+	// spawn the whole block's grains first, each held back until its onset, so every lane group is mixed in one pass
+	int frame = 0;
+	while (frame < frames)
+	{
+		if (index >= wait)
+		{
+			SpawnGrain(frame);
+		}
+		int run = std::min(frames - frame, std::max(wait - index, 1));
+		index += run;
+		frame += run;
+	}
+	RenderBlock(frames);
+
+	// fold the lanes together once per frame, then normalise by the number of grains sounding like GranularSynth
+	for (int f = 0; f < frames; f++)
+	{
+		float mix = 0;
+		float count = 0;
+		for (int l = 0; l < GRAIN_LANES; l++)
+		{
+			mix += mixLanes[f * GRAIN_LANES + l];
+			count += countLanes[f * GRAIN_LANES + l];
+		}
+		out[f] = (count > 0) ? mix / count : 0.0f;
+	}
+}
+
+float GrainCloud::GetSample()
+{
+	float samp;
+	ProcessBlock(&samp, 1);
+	return samp;
+}
+
+void GrainCloud::UpdateParams(int start, int finish, int wait)
+{
+	this->start = start;
+	this->finish = finish;
+	this->wait = wait;
+}
+
+void GrainCloud::SetRate(float rate)
+{
+	this->rate = rate;
+}
+
+void GrainCloud::SetParam(int param, float value)
+{
+	switch (param)
+	{
+	case grainStart: // moves the grain, keeping its length
+		finish += (int)round(value) - start;
+		start = (int)round(value);
+		break;
+	case grainLength:
+		finish = start + (int)round(value);
+		break;
+	case grainWait:
+		wait = (int)round(value);
+		break;
+	case grainRate:
+		rate = value;
+		break;
+	}
+}
+
+int GrainCloud::GetActiveGrains()
+{
+	return activeCount;
+}
+
+int GrainCloud::GetDroppedGrains()
+{
+	return droppedGrains;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "AudioMath.h"
+
+typedef std::vector<int, AlignedAllocator<int, TABLE_ALIGN> > laneInts; // ints aligned like a waveTable, for lane loads
+
+/*
+GrainCloud is an alternative to GranularSynth for very dense clouds.
+Instead of one Grain object per grain, all active grain state lives in flat arrays
+packed at the front, and blocks are mixed several grains at a time with SSE/AVX2.
+A block's grains are all spawned before it is mixed, so a grain that ends mid block frees its slot for the next one.
+*/
+
+class GrainCloud : public BaseSound
+{
+private:
+	waveTable* sourceWave;
+	sharedTable windowRef;
+	const waveTable* window;
+	int start;
+	int finish;
+	int wait; // samples to wait before starting a new grain
+	float rate;
+	int index = 0;
+
+	int maxGrains; // capacity, rounded up to a whole number of SIMD lanes
+	int activeCount = 0;
+	int droppedGrains = 0;
+
+	// one entry per active grain
+	waveTable positions; // read position in sourceWave
+	waveTable steps; // signed distance moved through sourceWave each frame
+	waveTable windowPhases; // read position in window
+	waveTable windowSteps;
+	laneInts remaining; // frames left to sound
+	laneInts delays; // frames left before the grain starts sounding, its onset within the block it was spawned in
+
+	waveTable mixLanes; // per frame, per lane partial mixes for the current block
+	waveTable countLanes;
+
+	void SpawnGrain(int onset);
+	void RenderBlock(int frames);
+	void RemoveFinishedGrains();
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
+public:
+	GrainCloud(waveTable* sourceWave, int start, int finish, float rate, int wait, int maxGrains);
+	float GetSample() override;
+	void UpdateParams(int start, int finish, int wait);
+	void SetRate(float rate);
+	void SetParam(int param, float value) override; // takes a grainParam
+	int GetActiveGrains();
+	int GetDroppedGrains();
+};
\ No newline at end of file
@@ -3,41 +3,74 @@
 #include "AudioMath.h"
 #include "WavFile.h"
 #include "osc.h"
+#include "ParamBridge.h"
+#include "OfflineRenderer.h"
+#include "CallbackMonitor.h"
+#include "OutputMeter.h"
+#include "VoiceManager.h"
 #include <string>
 #include <thread>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
 #define SAMPLE_RATE   (48000)
 #define NUM_SECONDS   (30000)
 #define PORT 12000
+#define OUTPUT_CHANNELS (2)
 
 class PaWrapper
 {
 private:
 	BaseSound* outputSound;
+	ParamBridge* params = nullptr;
+	long long framesRendered = 0; // stream position, what bundle timetags are scheduled against
 	PaStream* stream;
+	CallbackMonitor monitor;
+	OutputMeter meter;
+	float block[OUTPUT_CHANNELS][MAX_BLOCK_SIZE];
+	float* planes[OUTPUT_CHANNELS];
 
 	int paCallbackMethod(const void* inputBuffer, void* outputBuffer,
 		unsigned long framesPerBuffer,
 		const PaStreamCallbackTimeInfo* timeInfo,
 		PaStreamCallbackFlags statusFlags)
 	{
+		monitor.Begin();
 		float* out = (float*)outputBuffer;
 		unsigned long i;
+		unsigned long callbackFrames = framesPerBuffer;
 
 		(void)timeInfo; /* Prevent unused variable warnings. */
-		(void)statusFlags;
 		(void)inputBuffer;
 
-		for (i = 0; i < framesPerBuffer; i++)
+		if (params != nullptr)
 		{
-			float samp = outputSound->GetSample();
-			if ((samp > 1) || (samp < -1))
+			params->Publish(framesRendered);
+		}
+
+		while (framesPerBuffer > 0)
+		{
+			unsigned long frames = framesPerBuffer < MAX_BLOCK_SIZE ? framesPerBuffer : MAX_BLOCK_SIZE;
+			if (params != nullptr)
+			{
+				// stop the block short at the next scheduled update so it lands on its exact frame
+				params->Drain(framesRendered);
+				frames = params->FramesUntilNext(framesRendered, (int)frames);
+			}
+			outputSound->ProcessChannels(planes, OUTPUT_CHANNELS, (int)frames);
+			meter.Process(planes, (int)frames); // clipping is only counted here, the reporter thread prints it
+			for (i = 0; i < frames; i++)
 			{
-				printf("Clipping : %f\n", samp);
+				for (int c = 0; c < OUTPUT_CHANNELS; c++)
+				{
+					*out++ = block[c][i];
+				}
 			}
-			*out++ = samp;
-			*out++ = samp;
+			framesPerBuffer -= frames;
+			framesRendered += frames;
 		}
 
+		monitor.End(callbackFrames, statusFlags);
 		return paContinue;
 	}
 
@@ -56,8 +89,13 @@ private:
 	}
 public:
 	PaWrapper(BaseSound* out)
+		: monitor(SAMPLE_RATE), meter(OUTPUT_CHANNELS, SAMPLE_RATE)
 	{
 		outputSound = out;
+		for (int c = 0; c < OUTPUT_CHANNELS; c++)
+		{
+			planes[c] = block[c];
+		}
 	}
 
 	PaError Init()
@@ -69,7 +107,7 @@ public:
 	PaError OpenStream()
 	{
 		std::cout << "opening stream\n";
-		return Pa_OpenDefaultStream(&stream, 0, 2, paFloat32, SAMPLE_RATE, 32, &PaWrapper::paCallback, this);
+		return Pa_OpenDefaultStream(&stream, 0, OUTPUT_CHANNELS, paFloat32, SAMPLE_RATE, 32, &PaWrapper::paCallback, this);
 	}
 
 	PaError RunStream()
@@ -102,6 +140,26 @@ public:
 		outputSound = sound;
 	}
 
+	void SetParamBridge(ParamBridge* bridge)
+	{
+		params = bridge;
+	}
+
+	CallbackStats GetCallbackStats() // safe from any thread
+	{
+		return monitor.GetStats();
+	}
+
+	MeterStats TakeMeterStats() // from one thread only, each call covers the time since the last
+	{
+		return meter.TakeStats();
+	}
+
+	void SetProtection(outputProtection protection)
+	{
+		meter.SetProtection(protection);
+	}
+
 
 
 };
@@ -120,15 +178,96 @@ void ListenerThread(UdpListeningReceiveSocket *s)
 	s->RunUntilSigInt();
 }
 
-int main(void)
+void ReportThread(PaWrapper* pa, int statsPort, std::atomic<bool>* running) // prints clipping and, given a port, sends stats to it over OSC once a second
+{
+	UdpTransmitSocket* socket = nullptr;
+	if (statsPort > 0)
+	{
+		socket = new UdpTransmitSocket(IpEndpointName("127.0.0.1", statsPort));
+	}
+	while (*running)
+	{
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		MeterStats meterStats = pa->TakeMeterStats();
+		for (int c = 0; c < meterStats.channels; c++)
+		{
+			if (meterStats.clippedSamples[c] > 0)
+			{
+				std::cout << "Clipping : " << meterStats.clippedSamples[c] << " samples on channel " << c << ", peak " << meterStats.peak[c] << "\n";
+			}
+		}
+		if (socket != nullptr)
+		{
+			SendCallbackStats(*socket, pa->GetCallbackStats());
+			SendMeterStats(*socket, meterStats);
+		}
+	}
+	delete socket;
+}
+
+int main(int argc, char** argv)
 {
 	std::string filename = "C:/Users/bkier/source/repos/PASynth/demo.wav";
 
-	std::vector<float>* waveform = GetWaveform(filename);
+	// --render out.wav skips the audio device and writes the graph to a file as fast as it can
+	std::string renderFile;
+	RenderOptions renderOptions;
+	renderOptions.channels = OUTPUT_CHANNELS;
+	renderOptions.sampleRate = SAMPLE_RATE;
+	int threads = 1;
+	int statsPort = 0; // no stats are sent unless a port is given
+	outputProtection protection = noProtection;
+	int polyVoices = 0; // above 0, play a VoiceManager from OSC notes instead of the granular synth
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "usage: PASynth [--render out.wav] [--frames n] [--block n] [--threads n] [--stats port] [--protect none|soft|limit] [--poly voices]\n";
+			return 1;
+		}
+		if (arg == "--render")
+		{
+			renderFile = argv[++i];
+		}
+		else if (arg == "--frames")
+		{
+			renderOptions.frames = atoll(argv[++i]);
+		}
+		else if (arg == "--block")
+		{
+			renderOptions.blockSize = atoi(argv[++i]);
+		}
+		else if (arg == "--threads")
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (arg == "--stats")
+		{
+			statsPort = atoi(argv[++i]);
+		}
+		else if (arg == "--protect")
+		{
+			std::string mode = argv[++i];
+			protection = (mode == "soft") ? softClipProtection : (mode == "limit") ? limiterProtection : noProtection;
+		}
+		else if (arg == "--poly")
+		{
+			polyVoices = atoi(argv[++i]);
+		}
+		else
+		{
+			std::cout << "usage: PASynth [--render out.wav] [--frames n] [--block n] [--threads n] [--stats port] [--protect none|soft|limit] [--poly voices]\n";
+			return 1;
+		}
+	}
+
+	SampleBuffer* waveform = GetSampleBuffer(filename);
 
 
 	PaError err;
-	//ExamplePacketListener listener;
+	ParamBridge* params = new ParamBridge();
+	//ExamplePacketListener listener(params);
 	//UdpListeningReceiveSocket s(
 	//	IpEndpointName(IpEndpointName::ANY_ADDRESS, PORT),
 	//	&listener);
@@ -141,7 +280,35 @@ int main(void)
 	SGranSynth* granSynth = new SGranSynth(waveform, 120000, 127000, 1, 50, GranularSynth::windowType::hann, startRand, delayRand, rateRand);
 
 	WavePlayer* wf = new WavePlayer(waveform);
-	PaWrapper* pa = new PaWrapper((BaseSound*)granSynth);
+
+	if (threads > 1)
+	{
+		granSynth->EnableWorkers(threads);
+	}
+	if (!renderFile.empty())
+	{
+		RenderResult result = RenderToFile(granSynth, renderFile, renderOptions);
+		std::cout << result.frames << " frames in " << result.seconds << "s, " << result.realtimeFactor << "x realtime\n";
+		return result.ok ? 0 : 1;
+	}
+
+	BaseSound* output = granSynth;
+	VoiceManager* voiceManager = nullptr;
+	if (polyVoices > 0)
+	{
+		voiceManager = new VoiceManager(sawVoice, polyVoices);
+		voiceManager->SetLevel(0.25f); // room for a few loud notes before the sum clips
+		output = voiceManager;
+	}
+
+	PaWrapper* pa = new PaWrapper(output);
+
+	// the three wekinator outputs drive the grains
+	params->Bind("/wek/outputs", 0, granSynth, grainStart);
+	params->Bind("/wek/outputs", 1, granSynth, grainLength);
+	params->Bind("/wek/outputs", 2, granSynth, grainWait);
+	pa->SetParamBridge(params);
+	pa->SetProtection(protection);
 
 	
 	
@@ -158,12 +325,37 @@ int main(void)
 		return err;
 	}
 
+	std::atomic<bool> reporting(true);
+	std::thread reporter(ReportThread, pa, statsPort, &reporting);
+
+	// notes come in as /note/on and /note/off on PORT
+	ExamplePacketListener* noteListener = nullptr;
+	UdpListeningReceiveSocket* noteSocket = nullptr;
+	std::thread notes;
+	if (voiceManager != nullptr)
+	{
+		noteListener = new ExamplePacketListener(params, voiceManager);
+		noteSocket = new UdpListeningReceiveSocket(IpEndpointName(IpEndpointName::ANY_ADDRESS, PORT), noteListener);
+		notes = std::thread(ListenerThread, noteSocket);
+	}
+
 	err = pa->RunStream();
+	reporting = false;
+	reporter.join();
+	if (noteSocket != nullptr)
+	{
+		noteSocket->AsynchronousBreak();
+		notes.join();
+	}
 	if (err != paNoError)
 	{
 		return err;
 	}
 
+	CallbackStats callbackStats = pa->GetCallbackStats();
+	std::cout << callbackStats.callbacks << " callbacks, " << callbackStats.overruns << " over deadline, "
+		<< callbackStats.outputUnderflows << " underflows, worst " << callbackStats.maxMs << "ms of " << callbackStats.deadlineMs << "ms\n";
+
 	err = pa->CloseStream();
 	if (err != paNoError)
 	{
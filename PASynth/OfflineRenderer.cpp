@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "sndfile.h"
+#include "OfflineRenderer.h"
+
+RenderResult RenderToFile(BaseSound* sound, std::string filename, const RenderOptions& options)
+{
+	RenderResult result = { false, 0, 0.0, 0.0 };
+	int channels = std::max(1, std::min(options.channels, MAX_CHANNELS));
+	int blockSize = std::max(1, std::min(options.blockSize, MAX_BLOCK_SIZE));
+
+	SF_INFO sfinfo;
+	memset(&sfinfo, 0, sizeof(sfinfo));
+	sfinfo.samplerate = options.sampleRate;
+	sfinfo.channels = channels;
+	sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+	SNDFILE* f = sf_open(filename.c_str(), SFM_WRITE, &sfinfo);
+	if (f == nullptr)
+	{
+		std::cout << "couldn't open " << filename << " for writing: " << sf_strerror(nullptr) << "\n";
+		return result;
+	}
+
+	std::vector<waveTable> planeData(channels, waveTable(blockSize));
+	float* planes[MAX_CHANNELS];
+	for (int c = 0; c < channels; c++)
+	{
+		planes[c] = planeData[c].data();
+	}
+	waveTable interleaved(blockSize * channels);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ParamBridge* params = options.params;
+	if (params != nullptr)
+	{
+		// timetags land on frames counted from a fixed start, however fast the render runs
+		long long startNs = options.startNs;
+		if (startNs == 0)
+		{
+			startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+		params->UseFrameClock(startNs, options.sampleRate);
+	}
+	result.ok = true;
+	while (result.frames < options.frames)
+	{
+		int frames = (int)std::min((long long)blockSize, options.frames - result.frames);
+		if (params != nullptr)
+		{
+			params->Drain(result.frames);
+			frames = params->FramesUntilNext(result.frames, frames);
+		}
+		sound->ProcessChannels(planes, channels, frames);
+
+		for (int c = 0; c < channels; c++)
+		{
+			const float* plane = planes[c];
+			for (int i = 0; i < frames; i++)
+			{
+				interleaved[i * channels + c] = plane[i];
+			}
+		}
+		if (sf_writef_float(f, interleaved.data(), frames) != frames)
+		{
+			std::cout << "write to " << filename << " failed: " << sf_strerror(f) << "\n";
+			result.ok = false;
+			break;
+		}
+		result.frames += frames;
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.realtimeFactor = (result.seconds > 0) ? ((double)result.frames / options.sampleRate) / result.seconds : 0.0;
+
+	sf_close(f);
+	return result;
+}
+
+void RenderBatch(std::vector<RenderJob>& jobs, const RenderOptions& options, int threads)
+{
+	if (options.params != nullptr)
+	{
+		std::cout << "RenderBatch can't share one ParamBridge between jobs, set RenderJob::params instead\n";
+		for (size_t j = 0; j < jobs.size(); j++)
+		{
+			jobs[j].result = { false, 0, 0.0, 0.0 };
+		}
+		return;
+	}
+
+	// each thread takes the next job that nobody has started
+	std::atomic<int> nextJob(0);
+	auto worker = [&]()
+	{
+		int job;
+		while ((job = nextJob++) < (int)jobs.size())
+		{
+			RenderOptions jobOptions = options;
+			jobOptions.params = jobs[job].params;
+			jobs[job].result = RenderToFile(jobs[job].sound, jobs[job].filename, jobOptions);
+		}
+	};
+
+	std::vector<std::thread> helpers;
+	for (int t = 1; t < threads; t++)
+	{
+		helpers.push_back(std::thread(worker));
+	}
+	worker();
+	for (size_t t = 0; t < helpers.size(); t++)
+	{
+		helpers[t].join();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "AudioMath.h"
+#include "ParamBridge.h"
+
+/*
+Renders a sound graph straight to a float WAV as fast as the CPU allows, no audio device involved.
+Output only depends on the graph and the options, so renders double as repeatable benchmarks.
+*/
+
+struct RenderOptions
+{
+	long long frames = 48000 * 10;
+	int blockSize = MAX_BLOCK_SIZE; // frames pulled per call, at most MAX_BLOCK_SIZE
+	int channels = 2; // at most MAX_CHANNELS
+	int sampleRate = 48000;
+	ParamBridge* params = nullptr; // optional, scheduled updates are applied on their frame like PaWrapper does
+	long long startNs = 0; // system clock time of the first frame, 0 for when the render starts
+	// params runs on a frame clock from startNs, call params->UseFrameClock with the same start to schedule updates before rendering
+};
+
+struct RenderResult
+{
+	bool ok;
+	long long frames; // frames written
+	double seconds; // wall clock time spent rendering
+	double realtimeFactor; // seconds of audio per second of rendering
+};
+
+RenderResult RenderToFile(BaseSound* sound, std::string filename, const RenderOptions& options);
+
+struct RenderJob
+{
+	BaseSound* sound; // every job needs its own graph, jobs run at the same time
+	std::string filename;
+	RenderResult result;
+	ParamBridge* params = nullptr; // a bridge has a single consumer, so each job needs its own
+};
+
+void RenderBatch(std::vector<RenderJob>& jobs, const RenderOptions& options, int threads); // threads includes the caller, options.params must be null
\ No newline at end of file
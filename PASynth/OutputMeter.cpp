@@ -0,0 +1,122 @@
+#include <math.h>
+#include <algorithm>
+#include "OutputMeter.h"
+
+#define SOFT_CLIP_KNEE (0.8f) // the soft clipper is linear up to here
+#define LIMITER_RELEASE_SECONDS (0.05f) // time for the limiter gain to recover by about 63%
+
+OutputMeter::OutputMeter(int channels, float sampleRate)
+{
+	this->channels = std::min(channels, MAX_CHANNELS);
+	limiterRelease = expf(-1.0f / (LIMITER_RELEASE_SECONDS * sampleRate));
+	for (int c = 0; c < MAX_CHANNELS; c++)
+	{
+		peak[c] = 0;
+		clippedSamples[c] = 0;
+		reportedClips[c] = 0;
+	}
+	minGain = 1;
+}
+
+void OutputMeter::SetProtection(outputProtection protection)
+{
+	this->protection = protection;
+}
+
+void OutputMeter::Process(float* const* out, int frames)
+{
+	for (int c = 0; c < channels; c++)
+	{
+		const float* plane = out[c];
+		float blockPeak = 0;
+		int clips = 0;
+		for (int i = 0; i < frames; i++)
+		{
+			float level = fabsf(plane[i]);
+			blockPeak = std::max(blockPeak, level);
+			clips += (level > 1.0f);
+		}
+
+		// compare and swap, so a reset from TakeStats is never overwritten by an older, higher peak
+		float seen = peak[c].load(std::memory_order_relaxed);
+		while (blockPeak > seen && !peak[c].compare_exchange_weak(seen, blockPeak, std::memory_order_relaxed))
+		{
+		}
+		if (clips > 0)
+		{
+			clippedSamples[c].store(clippedSamples[c].load(std::memory_order_relaxed) + clips, std::memory_order_relaxed);
+		}
+	}
+
+	if (protection == softClipProtection)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			SoftClip(out[c], frames);
+		}
+	}
+	else if (protection == limiterProtection)
+	{
+		Limit(out, frames);
+	}
+}
+
+void OutputMeter::SoftClip(float* out, int frames)
+{
+	// linear below the knee, above it tanh bends the rest of the range in so nothing passes 1
+	const float range = 1.0f - SOFT_CLIP_KNEE;
+	for (int i = 0; i < frames; i++)
+	{
+		float level = fabsf(out[i]);
+		if (level > SOFT_CLIP_KNEE)
+		{
+			float bent = SOFT_CLIP_KNEE + range * tanhf((level - SOFT_CLIP_KNEE) / range);
+			out[i] = (out[i] < 0) ? -bent : bent;
+		}
+	}
+}
+
+void OutputMeter::Limit(float* const* out, int frames)
+{
+	// instant attack, so the envelope is never below the sample it scales and the output never passes 1
+	float lowest = 1;
+	for (int i = 0; i < frames; i++)
+	{
+		float level = 0;
+		for (int c = 0; c < channels; c++)
+		{
+			level = std::max(level, fabsf(out[c][i]));
+		}
+		envelope = std::max(level, envelope * limiterRelease);
+		if (envelope > 1.0f)
+		{
+			float gain = 1.0f / envelope;
+			lowest = std::min(lowest, gain);
+			for (int c = 0; c < channels; c++)
+			{
+				out[c][i] *= gain;
+			}
+		}
+	}
+	float seen = minGain.load(std::memory_order_relaxed);
+	while (lowest < seen && !minGain.compare_exchange_weak(seen, lowest, std::memory_order_relaxed))
+	{
+	}
+}
+
+MeterStats OutputMeter::TakeStats()
+{
+	MeterStats stats;
+	stats.channels = channels;
+	stats.totalClippedSamples = 0;
+	for (int c = 0; c < channels; c++)
+	{
+		stats.peak[c] = peak[c].exchange(0.0f);
+		long long total = clippedSamples[c].load(std::memory_order_relaxed);
+		stats.clippedSamples[c] = total - reportedClips[c];
+		reportedClips[c] = total;
+		stats.totalClippedSamples += stats.clippedSamples[c];
+	}
+	stats.minGain = minGain.exchange(1.0f);
+	return stats;
+}
\ No newline at end of file
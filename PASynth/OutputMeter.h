@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include "AudioMath.h"
+
+enum outputProtection { noProtection, softClipProtection, limiterProtection };
+
+struct MeterStats
+{
+	int channels;
+	float peak[MAX_CHANNELS]; // largest magnitude since the last TakeStats, before any protection
+	long long clippedSamples[MAX_CHANNELS]; // samples outside -1 to 1 since the last TakeStats
+	long long totalClippedSamples;
+	float minGain; // deepest limiter gain reduction since the last TakeStats, 1 if it never engaged
+};
+
+/*
+Peak and clip metering for the output, run by the audio thread on each block just before it goes to the device.
+The audio thread never blocks or prints, it only stores into atomics, a reporter thread takes the numbers with TakeStats.
+It can also keep the output inside -1 to 1, either with a soft clipper or a peak limiter.
+*/
+class OutputMeter
+{
+private:
+	int channels;
+	outputProtection protection = noProtection;
+	float limiterRelease; // per sample envelope decay
+	float envelope = 0; // limiter's peak follower, linked across channels
+
+	std::atomic<float> peak[MAX_CHANNELS]; // reset by the reader, so peaks land in one report or the next but are never lost
+	std::atomic<long long> clippedSamples[MAX_CHANNELS]; // running totals, only the audio thread writes
+	std::atomic<float> minGain;
+	long long reportedClips[MAX_CHANNELS]; // reader's copy of the totals at the last report
+
+	void SoftClip(float* out, int frames);
+	void Limit(float* const* out, int frames);
+
+public:
+	OutputMeter(int channels, float sampleRate);
+	void SetProtection(outputProtection protection); // before the stream starts
+
+	void Process(float* const* out, int frames); // audio thread, meters the block then applies the protection in place
+	MeterStats TakeStats(); // one reader thread
+};
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include "ParamBridge.h"
+
+#define SAMPLE_RATE (48000)
+#define NTP_UNIX_OFFSET (2208988800LL) // seconds from 1900, the OSC epoch, to 1970
+#define OSC_IMMEDIATELY (1) // the timetag meaning "as soon as possible"
+
+static long long SteadyNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ParamBridge::ParamBridge(int capacity)
+	: queue(capacity)
+{
+	droppedUpdates = 0;
+	pending.reserve(queue.Capacity());
+	anchorSeq = 0;
+	anchorFrame = 0;
+	anchorNs = 0;
+	frameClockStartNs = 0;
+	frameClockRate = SAMPLE_RATE;
+}
+
+void ParamBridge::UseFrameClock(long long startNs, int sampleRate)
+{
+	frameClockRate = sampleRate;
+	frameClockStartNs = startNs;
+}
+
+int ParamBridge::Bind(const std::string& address, BaseSound* target, int param)
+{
+	return Bind(address, 0, target, param);
+}
+
+int ParamBridge::Bind(const std::string& address, int argument, BaseSound* target, int param)
+{
+	Binding binding = { target, param };
+	bindings.push_back(binding);
+	int id = (int)bindings.size() - 1;
+
+	std::vector<int>* arguments = addresses.Find(address.c_str());
+	if (arguments == nullptr)
+	{
+		addresses.Add(address.c_str(), std::vector<int>());
+		arguments = addresses.Find(address.c_str());
+	}
+	if ((int)arguments->size() <= argument)
+	{
+		arguments->resize(argument + 1, -1);
+	}
+	(*arguments)[argument] = id;
+	return id;
+}
+
+int ParamBridge::Find(const std::string& address, int argument)
+{
+	std::vector<int>* arguments = addresses.Find(address.c_str());
+	if (arguments == nullptr || argument >= (int)arguments->size())
+	{
+		return -1;
+	}
+	return (*arguments)[argument];
+}
+
+bool ParamBridge::Push(int id, float value, long long frame)
+{
+	ParamUpdate update;
+	update.id = id;
+	update.value = value;
+	update.receivedNs = SteadyNs();
+	update.frame = frame;
+
+	if (!queue.Push(update))
+	{
+		droppedUpdates++;
+		return false;
+	}
+	return true;
+}
+
+long long ParamBridge::FrameAt(uint64_t timeTag)
+{
+	if (timeTag == OSC_IMMEDIATELY)
+	{
+		return IMMEDIATE_FRAME;
+	}
+
+	long long tagNs = ((long long)(timeTag >> 32) - NTP_UNIX_OFFSET) * 1000000000LL
+		+ (long long)(((timeTag & 0xffffffffULL) * 1000000000ULL) >> 32);
+	long long startNs = frameClockStartNs.load();
+	if (startNs != 0) // no stream to follow, the frame clock alone says where the tag lands
+	{
+		return llround((tagNs - startNs) * (frameClockRate.load() / 1e9));
+	}
+
+	unsigned seq;
+	long long frame;
+	long long ns;
+	do
+	{
+		seq = anchorSeq.load();
+		frame = anchorFrame.load();
+		ns = anchorNs.load();
+	} while ((seq & 1) || seq != anchorSeq.load());
+
+	if (seq == 0) // the stream hasn't started, there is nothing to schedule against
+	{
+		return IMMEDIATE_FRAME;
+	}
+
+	// timetags are wall clock, move the offset onto the steady clock the anchor was taken with
+	long long systemNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	long long targetNs = SteadyNs() + (tagNs - systemNs);
+
+	return frame + llround((targetNs - ns) * (SAMPLE_RATE / 1e9));
+}
+
+void ParamBridge::Publish(long long frame)
+{
+	anchorSeq++;
+	anchorFrame = frame;
+	anchorNs = SteadyNs();
+	anchorSeq++;
+}
+
+void ParamBridge::Apply(const ParamUpdate& update)
+{
+	Binding& binding = bindings[update.id];
+	binding.target->SetParam(binding.param, update.value);
+}
+
+void ParamBridge::Schedule(const ParamUpdate& update)
+{
+	if (pending.size() == pending.capacity()) // never grow on the audio thread, apply early instead
+	{
+		lateUpdates++;
+		Apply(update);
+		return;
+	}
+
+	// in front of any update due at the same frame, so those pushed first still apply first
+	std::vector<ParamUpdate>::iterator at = std::lower_bound(pending.begin(), pending.end(), update.frame,
+		[](const ParamUpdate& u, long long frame) { return u.frame > frame; });
+	pending.insert(at, update);
+}
+
+void ParamBridge::Drain(long long frame)
+{
+	while (!pending.empty() && pending.back().frame <= frame)
+	{
+		Apply(pending.back());
+		pending.pop_back();
+	}
+
+	ParamUpdate update;
+	while (queue.Pop(update))
+	{
+		if (update.frame > frame)
+		{
+			Schedule(update);
+		}
+		else
+		{
+			if (update.frame != IMMEDIATE_FRAME && update.frame < frame)
+			{
+				lateUpdates++;
+			}
+			Apply(update);
+		}
+	}
+}
+
+int ParamBridge::FramesUntilNext(long long frame, int maxFrames)
+{
+	if (pending.empty())
+	{
+		return maxFrames;
+	}
+	return (int)std::min((long long)maxFrames, pending.back().frame - frame);
+}
+
+int ParamBridge::GetDroppedUpdates()
+{
+	return droppedUpdates;
+}
+
+int ParamBridge::GetLateUpdates()
+{
+	return lateUpdates;
+}
\ No newline at end of file
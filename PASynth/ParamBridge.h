@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AudioMath.h"
+#include "SpscQueue.h"
+#include "osc/OscAddressDispatcher.h"
+
+struct ParamUpdate
+{
+	int id; // binding returned by ParamBridge::Bind
+	float value;
+	long long receivedNs; // steady clock time the update was pushed
+	long long frame; // output frame to apply it at, IMMEDIATE_FRAME for the next block
+};
+
+#define IMMEDIATE_FRAME (-1)
+
+/*
+Carries parameter changes from one control thread (the OSC listener) to the audio thread.
+Parameters are bound by name up front, the control thread pushes updates into a lock free queue,
+and the audio thread drains it once per block, calling SetParam on each target.
+Updates can carry an output frame, the audio thread holds them back and splits its block so each lands on that exact frame.
+*/
+class ParamBridge
+{
+private:
+	struct Binding
+	{
+		BaseSound* target;
+		int param;
+	};
+
+	std::vector<Binding> bindings;
+	osc::AddressDispatcher<std::vector<int>> addresses; // binding id for each argument of an address, -1 if unbound
+	SpscQueue<ParamUpdate> queue;
+	std::atomic<int> droppedUpdates;
+
+	// updates waiting for their frame, latest first so the next one due is at the back
+	std::vector<ParamUpdate> pending;
+	int lateUpdates = 0;
+
+	// where the audio thread last saw the stream, so the control thread can turn times into frames
+	std::atomic<unsigned> anchorSeq; // odd while the anchor is being written
+	std::atomic<long long> anchorFrame;
+	std::atomic<long long> anchorNs;
+
+	// an offline render runs faster than real time, so its time comes from the frame count instead
+	std::atomic<long long> frameClockStartNs; // system clock time of frame 0, 0 while following the real clocks
+	std::atomic<int> frameClockRate;
+
+	void Apply(const ParamUpdate& update);
+	void Schedule(const ParamUpdate& update);
+
+public:
+	ParamBridge(int capacity = 1024);
+
+	// setup, before the stream starts
+	int Bind(const std::string& address, BaseSound* target, int param);
+	int Bind(const std::string& address, int argument, BaseSound* target, int param);
+	void UseFrameClock(long long startNs, int sampleRate); // frame n is at startNs + n / sampleRate, for rendering offline
+
+	// control thread
+	int Find(const std::string& address, int argument = 0); // -1 if nothing is bound
+	template <class F>
+	int Dispatch(const char* addressPattern, F f); // calls f with the argument bindings of every address the pattern matches
+	bool Push(int id, float value, long long frame = IMMEDIATE_FRAME);
+	long long FrameAt(uint64_t timeTag); // OSC/NTP timetag to output frame, IMMEDIATE_FRAME for the "now" tag
+
+	// audio thread
+	void Publish(long long frame); // call at the top of each callback with the first frame it renders
+	void Drain(long long frame); // apply everything due at or before frame
+	int FramesUntilNext(long long frame, int maxFrames); // frames that can be rendered before the next pending update
+
+	int GetDroppedUpdates(); // pushes lost to a full queue
+	int GetLateUpdates(); // scheduled updates that arrived after their frame had been rendered
+};
+
+template <class F>
+int ParamBridge::Dispatch(const char* addressPattern, F f)
+{
+	return addresses.Dispatch(addressPattern, f);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+xoshiro256++ by Blackman and Vigna: four words of state, a few shifts and adds per 64 bit output.
+Every random source owns its own, so draws never touch shared state and any thread can make them.
+Seeds go through splitmix64 first, so even neighbouring seeds start from unrelated states.
+*/
+class Xoshiro256
+{
+private:
+	uint64_t s[4];
+
+	static uint64_t Rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+public:
+	Xoshiro256(uint64_t seed = 1)
+	{
+		Seed(seed);
+	}
+
+	void Seed(uint64_t seed)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			s[i] = z ^ (z >> 31);
+		}
+	}
+
+	uint64_t Next()
+	{
+		uint64_t result = Rotl(s[0] + s[3], 23) + s[0];
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = Rotl(s[3], 45);
+		return result;
+	}
+
+	double NextDouble() // uniform in [0, 1)
+	{
+		return (Next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/*
+Bounded lock free queue for exactly one producer thread and one consumer thread.
+Neither side ever blocks or allocates, so either end can sit on the audio thread.
+*/
+template <class T>
+class SpscQueue
+{
+private:
+	std::vector<T> items;
+	size_t mask;
+	std::atomic<size_t> head; // next item to pop, only the consumer writes it
+	char padding[64]; // keeps head and tail on separate cache lines
+	std::atomic<size_t> tail; // next slot to push into, only the producer writes it
+
+public:
+	SpscQueue(size_t capacity) // rounded up to a power of two
+	{
+		size_t size = 1;
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+		items.resize(size);
+		mask = size - 1;
+		head = 0;
+		tail = 0;
+	}
+
+	bool Push(const T& item) // false if the queue is full
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == items.size())
+		{
+			return false;
+		}
+		items[t & mask] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& item) // false if the queue is empty
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = items[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t PushSome(const T* source, size_t count) // copies in as many as fit, returns how many
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		count = std::min(count, items.size() - (t - head.load(std::memory_order_acquire)));
+		size_t first = std::min(count, items.size() - (t & mask)); // up to the end of the buffer, then wrap
+		std::copy(source, source + first, items.begin() + (t & mask));
+		std::copy(source + first, source + count, items.begin());
+		tail.store(t + count, std::memory_order_release);
+		return count;
+	}
+
+	size_t PopSome(T* dest, size_t count) // copies out as many as are queued, returns how many
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		count = std::min(count, tail.load(std::memory_order_acquire) - h);
+		size_t first = std::min(count, items.size() - (h & mask));
+		std::copy(items.begin() + (h & mask), items.begin() + (h & mask) + first, dest);
+		std::copy(items.begin(), items.begin() + (count - first), dest + first);
+		head.store(h + count, std::memory_order_release);
+		return count;
+	}
+
+	size_t Size()
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	size_t Capacity()
+	{
+		return items.size();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include "StreamingWavePlayer.h"
+
+#define STREAM_POLL_MS (2) // how long the I/O thread sleeps when the ring is full
+
+StreamingWavePlayer::StreamingWavePlayer(std::string filename, int prefetchFrames, bool loop)
+{
+	this->loop = loop;
+	running = false;
+	finished = false;
+	underruns = 0;
+	underrunFrames = 0;
+
+	SF_INFO sfinfo;
+	memset(&sfinfo, 0, sizeof(sfinfo));
+	file = sf_open(filename.c_str(), SFM_READ, &sfinfo);
+	if (file == nullptr)
+	{
+		std::cout << "couldn't open " << filename << ": " << sf_strerror(nullptr) << "\n";
+		finished = true;
+		ring = new SpscQueue<float>(1);
+		readBuffer = nullptr;
+		block = new float[MAX_BLOCK_SIZE];
+		return;
+	}
+	channels = sfinfo.channels;
+	if (sfinfo.frames == 0)
+	{
+		finished = true; // nothing to loop over
+	}
+
+	ring = new SpscQueue<float>((size_t)prefetchFrames * channels);
+	readBuffer = new float[STREAM_READ_FRAMES * channels];
+	block = new float[MAX_BLOCK_SIZE * channels];
+
+	// fill the whole window up front so playback doesn't start with an underrun
+	while (ReadAhead() > 0)
+	{
+	}
+
+	running = true;
+	reader = std::thread(&StreamingWavePlayer::ReaderLoop, this);
+}
+
+StreamingWavePlayer::~StreamingWavePlayer()
+{
+	if (reader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeLock);
+			running = false;
+		}
+		wake.notify_one();
+		reader.join();
+	}
+	if (file != nullptr)
+	{
+		sf_close(file);
+	}
+	delete ring;
+	delete[] readBuffer;
+	delete[] block;
+}
+
+int StreamingWavePlayer::ReadAhead()
+{
+	if (finished)
+	{
+		return 0;
+	}
+
+	int space = (int)(ring->Capacity() - ring->Size()) / channels;
+	int frames = std::min(space, STREAM_READ_FRAMES);
+	if (frames <= 0)
+	{
+		return 0;
+	}
+
+	sf_count_t got = sf_readf_float(file, readBuffer, frames);
+	if (got < frames)
+	{
+		if (loop && sf_seek(file, 0, SEEK_SET) == 0)
+		{
+			// the rest of this read comes from the start of the file on the next pass
+		}
+		else
+		{
+			finished = true;
+		}
+	}
+	if (got <= 0)
+	{
+		return finished ? 0 : 1; // nothing this time, but a loop wrapped so keep reading
+	}
+
+	return (int)ring->PushSome(readBuffer, (size_t)got * channels);
+}
+
+void StreamingWavePlayer::ReaderLoop()
+{
+	while (running)
+	{
+		if (ReadAhead() > 0)
+		{
+			continue;
+		}
+
+		// full or finished, the audio thread never signals so just check back shortly
+		std::unique_lock<std::mutex> lock(wakeLock);
+		wake.wait_for(lock, std::chrono::milliseconds(STREAM_POLL_MS), [this] { return !running; });
+	}
+}
+
+void StreamingWavePlayer::Underrun(int missing)
+{
+	if (finished && ring->Size() == 0)
+	{
+		return; // the file just ended, that's not the disk falling behind
+	}
+	underruns++;
+	underrunFrames += missing;
+}
+
+int StreamingWavePlayer::PopFrames(int frames)
+{
+	int got = (int)ring->PopSome(block, (size_t)frames * channels) / channels;
+	if (got < frames)
+	{
+		Underrun(frames - got);
+	}
+	return got;
+}
+
+float StreamingWavePlayer::GetSample()
+{
+	float samp = 0;
+	if (PopFrames(1) == 1)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			samp += block[c];
+		}
+		samp /= channels;
+	}
+	return samp;
+}
+
+void StreamingWavePlayer::ProcessBlock(float* out, int frames)
+{
+	int got = PopFrames(frames);
+	for (int i = 0; i < got; i++)
+	{
+		float sum = 0;
+		for (int c = 0; c < channels; c++)
+		{
+			sum += block[i * channels + c];
+		}
+		out[i] = (channels == 1) ? sum : sum / channels;
+	}
+	std::fill(out + got, out + frames, 0.0f);
+}
+
+void StreamingWavePlayer::ProcessBlockChannels(float* const* out, int outChannels, int frames)
+{
+	if (outChannels == 1)
+	{
+		ProcessBlock(out[0], frames);
+		return;
+	}
+	int got = PopFrames(frames);
+	for (int c = 0; c < outChannels; c++)
+	{
+		const float* in = block + (c % channels);
+		float* plane = out[c];
+		for (int i = 0; i < got; i++)
+		{
+			plane[i] = in[i * channels];
+		}
+		std::fill(plane + got, plane + frames, 0.0f);
+	}
+}
+
+int StreamingWavePlayer::GetChannels()
+{
+	return channels;
+}
+
+bool StreamingWavePlayer::IsOpen()
+{
+	return file != nullptr;
+}
+
+int StreamingWavePlayer::GetUnderruns()
+{
+	return underruns;
+}
+
+long long StreamingWavePlayer::GetUnderrunFrames()
+{
+	return underrunFrames;
+}
+
+int StreamingWavePlayer::GetBufferedFrames()
+{
+	return (int)ring->Size() / channels;
+}
+
+int StreamingWavePlayer::GetPrefetchFrames()
+{
+	return (int)ring->Capacity() / channels;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "sndfile.h"
+#include "AudioMath.h"
+#include "SpscQueue.h"
+
+#define STREAM_READ_FRAMES (4096) // frames the I/O thread reads from disk at a time
+
+/*
+WavePlayer for files too big to hold in memory.
+A background thread reads ahead from disk into a lock free ring, the audio thread only ever copies out of it.
+If the disk falls behind the player outputs silence rather than waiting, and counts the underrun.
+Channels map onto the output like WavePlayer's, and it loops at the end of the file unless told not to.
+*/
+
+class StreamingWavePlayer : public BaseSound
+{
+private:
+	SNDFILE* file = nullptr;
+	int channels = 1;
+	bool loop;
+
+	SpscQueue<float>* ring; // interleaved, only ever holds whole frames
+	float* readBuffer; // I/O thread only
+	float* block; // audio thread only, one block of interleaved frames
+	std::thread reader;
+	std::atomic<bool> running;
+	std::atomic<bool> finished; // the end of a non looping file has been queued
+	std::mutex wakeLock;
+	std::condition_variable wake;
+
+	std::atomic<int> underruns; // blocks that came up short
+	std::atomic<long long> underrunFrames; // frames replaced with silence
+
+	int ReadAhead(); // I/O thread, fills what space the ring has, returns samples queued
+	void ReaderLoop();
+	void Underrun(int missing);
+	int PopFrames(int frames); // into block, returns how many frames came out
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+	void ProcessBlockChannels(float* const* out, int channels, int frames) override;
+
+public:
+	StreamingWavePlayer(std::string filename, int prefetchFrames = 1 << 18, bool loop = true); // prefetch is filled before returning
+	~StreamingWavePlayer();
+	float GetSample() override;
+	int GetChannels() override;
+	bool IsOpen();
+	int GetUnderruns();
+	long long GetUnderrunFrames();
+	int GetBufferedFrames(); // how full the prefetch window is right now
+	int GetPrefetchFrames(); // its capacity
+};
\ No newline at end of file
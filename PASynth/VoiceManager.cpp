@@ -0,0 +1,278 @@
+#include <math.h>
+#include <algorithm>
+#include "VoiceManager.h"
+
+#define SAMPLE_RATE (48000)
+#define NOTE_QUEUE_SIZE (1024)
+
+static float NoteFrequency(int note)
+{
+	return 440.0f * powf(2.0f, (note - 69) / 12.0f);
+}
+
+VoiceManager::VoiceManager(voiceShape shape, int maxVoices, int tabSize, SampleBuffer* sample)
+	: events(NOTE_QUEUE_SIZE)
+{
+	if (shape == sampleVoice && sample == nullptr)
+	{
+		shape = sawVoice; // nothing to play, so keep the voices sounding
+	}
+	droppedEvents = 0;
+	voices.resize(maxVoices);
+	freeVoices = new int[maxVoices];
+	activeVoices = new int[maxVoices];
+	for (int v = 0; v < maxVoices; v++)
+	{
+		Voice& voice = voices[v];
+		voice.freq = nullptr;
+		voice.player = nullptr;
+		if (shape == sampleVoice)
+		{
+			voice.player = new WavePlayer(sample);
+			voice.sound = voice.player;
+		}
+		else
+		{
+			voice.freq = new Sig(440.0f);
+			if (shape == sawVoice)
+			{
+				voice.sound = new Saw((BaseSound*)voice.freq, 1.0f, tabSize, 0.0f);
+			}
+			else
+			{
+				voice.sound = new Sine((BaseSound*)voice.freq, 1.0f, tabSize, 0.0f);
+			}
+		}
+		voice.note = -1;
+		voice.gain = 0;
+		voice.target = 0;
+		voice.started = 0;
+		voice.pendingNote = -1;
+		voice.pendingVelocity = 0;
+		freeVoices[freeCount++] = maxVoices - 1 - v; // voice 0 is handed out first
+	}
+	SetEnvelope(DEFAULT_ATTACK_SECONDS, DEFAULT_RELEASE_SECONDS);
+}
+
+void VoiceManager::SetEnvelope(float attackSeconds, float releaseSeconds)
+{
+	// linear ramps over a full scale swing, so a soft note reaches its level sooner
+	attackStep = 1.0f / std::max(1.0f, attackSeconds * SAMPLE_RATE);
+	releaseStep = 1.0f / std::max(1.0f, releaseSeconds * SAMPLE_RATE);
+	stealStep = std::max(releaseStep, 1.0f / (STEAL_FADE_SECONDS * SAMPLE_RATE));
+}
+
+void VoiceManager::SetLevel(float level)
+{
+	this->level = level;
+}
+
+void VoiceManager::SetParam(int param, float value)
+{
+	(void)param;
+	level = value;
+}
+
+bool VoiceManager::PushNote(int note, float velocity)
+{
+	NoteEvent event = { note, velocity };
+	if (!events.Push(event))
+	{
+		droppedEvents++;
+		return false;
+	}
+	return true;
+}
+
+int VoiceManager::StealVoice()
+{
+	// the quietest released voice is the least missed, failing that the oldest held one
+	int best = 0;
+	for (int i = 1; i < activeCount; i++)
+	{
+		const Voice& candidate = voices[activeVoices[i]];
+		const Voice& current = voices[activeVoices[best]];
+		bool candidateReleased = candidate.target == 0;
+		bool currentReleased = current.target == 0;
+		if (candidateReleased != currentReleased)
+		{
+			if (candidateReleased)
+			{
+				best = i;
+			}
+		}
+		else if (candidateReleased ? candidate.gain < current.gain : candidate.started < current.started)
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+void VoiceManager::NoteOn(int note, float velocity)
+{
+	Voice* voice = nullptr;
+	for (int i = 0; i < activeCount && voice == nullptr; i++) // a repeated note retriggers its own voice
+	{
+		const Voice& candidate = voices[activeVoices[i]];
+		if (candidate.note == note || candidate.pendingNote == note)
+		{
+			voice = &voices[activeVoices[i]];
+		}
+	}
+	if (voice == nullptr && freeCount > 0)
+	{
+		int v = freeVoices[--freeCount];
+		activeVoices[activeCount++] = v;
+		voice = &voices[v];
+	}
+	if (voice == nullptr)
+	{
+		if (activeCount == 0) // no voices at all
+		{
+			return;
+		}
+		voice = &voices[activeVoices[StealVoice()]];
+		stolenVoices++;
+	}
+
+	voice->started = notesPlayed++;
+	bool jumps = (voice->player != nullptr) || (voice->note != note); // a restart or a new pitch moves the waveform
+	if (voice->gain > 0 && jumps)
+	{
+		// changing it at its current level would click, so fade it out first and let ProcessBlock start the note
+		voice->note = -1;
+		voice->target = 0;
+		voice->pendingNote = note;
+		voice->pendingVelocity = velocity;
+		return;
+	}
+	StartNote(*voice, note, velocity);
+}
+
+void VoiceManager::StartNote(Voice& voice, int note, float velocity)
+{
+	// the envelope carries on from wherever the voice was, which is silence unless the pitch is unchanged
+	voice.note = note;
+	voice.target = velocity;
+	voice.pendingNote = -1;
+	if (voice.freq != nullptr)
+	{
+		voice.freq->SetParam(0, NoteFrequency(note));
+	}
+	if (voice.player != nullptr)
+	{
+		voice.player->Seek(0);
+	}
+}
+
+void VoiceManager::NoteOff(int note)
+{
+	for (int i = 0; i < activeCount; i++)
+	{
+		Voice& voice = voices[activeVoices[i]];
+		if (voice.note == note)
+		{
+			voice.target = 0;
+		}
+		if (voice.pendingNote == note) // let go before it got to sound, the fade just finishes
+		{
+			voice.pendingNote = -1;
+		}
+	}
+}
+
+void VoiceManager::ReleaseVoice(int activeIndex)
+{
+	int v = activeVoices[activeIndex];
+	voices[v].note = -1;
+	freeVoices[freeCount++] = v;
+	activeVoices[activeIndex] = activeVoices[--activeCount];
+}
+
+void VoiceManager::ProcessBlock(float* out, int frames)
+{
+	NoteEvent event;
+	while (events.Pop(event))
+	{
+		if (event.velocity > 0)
+		{
+			NoteOn(event.note, event.velocity);
+		}
+		else
+		{
+			NoteOff(event.note);
+		}
+	}
+
+	std::fill(out, out + frames, 0.0f);
+	for (int i = 0; i < activeCount;)
+	{
+		Voice& voice = voices[activeVoices[i]];
+		voice.sound->Process(scratch, frames);
+
+		float gain = voice.gain;
+		if (gain == voice.target)
+		{
+			for (int n = 0; n < frames; n++)
+			{
+				out[n] += scratch[n] * gain;
+			}
+		}
+		else
+		{
+			float target = voice.target;
+			float fallStep = (voice.pendingNote >= 0) ? stealStep : releaseStep;
+			for (int n = 0; n < frames; n++)
+			{
+				gain = (gain < target) ? std::min(target, gain + attackStep) : std::max(target, gain - fallStep);
+				out[n] += scratch[n] * gain;
+			}
+			voice.gain = gain;
+		}
+
+		if (voice.gain == 0 && voice.pendingNote >= 0)
+		{
+			StartNote(voice, voice.pendingNote, voice.pendingVelocity); // faded out, so it sounds from the next block
+			i++;
+		}
+		else if (voice.gain == 0 && voice.target == 0)
+		{
+			ReleaseVoice(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (level != 1.0f)
+	{
+		for (int n = 0; n < frames; n++)
+		{
+			out[n] *= level;
+		}
+	}
+}
+
+float VoiceManager::GetSample()
+{
+	float samp;
+	ProcessBlock(&samp, 1);
+	return samp;
+}
+
+int VoiceManager::GetActiveVoices()
+{
+	return activeCount;
+}
+
+int VoiceManager::GetStolenVoices()
+{
+	return stolenVoices;
+}
+
+int VoiceManager::GetDroppedEvents()
+{
+	return droppedEvents;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "AudioMath.h"
+#include "SpscQueue.h"
+
+#define DEFAULT_ATTACK_SECONDS (0.005f)
+#define DEFAULT_RELEASE_SECONDS (0.05f)
+#define STEAL_FADE_SECONDS (0.003f) // how long a sounding voice takes to fade out before it is retuned for another note
+
+enum voiceShape { sineVoice, sawVoice, sampleVoice };
+
+struct NoteEvent
+{
+	int note; // MIDI note number, sets the pitch of sine and saw voices
+	float velocity; // 0 to 1, 0 releases the note
+};
+
+/*
+A fixed set of voices played by note on and note off, summed to one output.
+Every voice is built up front, notes arrive from a control thread (the OSC listener) through a lock free queue,
+and only voices that are sounding are rendered, a block at a time each.
+With every voice busy a new note takes over the one that is quietest in its release, or else the oldest.
+A voice that is still sounding is faded out before it is retuned or restarted, then the new note starts from silence.
+*/
+class VoiceManager : public BaseSound
+{
+private:
+	struct Voice
+	{
+		BaseSound* sound;
+		Sig* freq; // pitch of sine and saw voices
+		WavePlayer* player; // sample voices, restarted by each note
+		int note;
+		float gain; // envelope level now
+		float target; // velocity while held, 0 once released
+		long long started; // note on order, the oldest is stolen first
+		int pendingNote; // started once the voice has faded out, -1 if nothing is waiting
+		float pendingVelocity;
+	};
+
+	std::vector<Voice> voices;
+	int* freeVoices; // stack of voices that are silent
+	int freeCount = 0;
+	int* activeVoices; // voices that are sounding, held or releasing
+	int activeCount = 0;
+
+	SpscQueue<NoteEvent> events;
+	std::atomic<int> droppedEvents;
+	long long notesPlayed = 0;
+	int stolenVoices = 0;
+
+	float attackStep; // envelope change per sample
+	float releaseStep;
+	float stealStep;
+	float level = 1.0f;
+	float scratch[MAX_BLOCK_SIZE];
+
+	void NoteOn(int note, float velocity);
+	void StartNote(Voice& voice, int note, float velocity); // retunes or restarts the voice, so only while it's silent
+	void NoteOff(int note);
+	int StealVoice(); // index into activeVoices
+	void ReleaseVoice(int activeIndex);
+
+protected:
+	void ProcessBlock(float* out, int frames) override;
+
+public:
+	VoiceManager(voiceShape shape, int maxVoices, int tabSize = 2048, SampleBuffer* sample = nullptr); // sample is only for sampleVoice, which falls back to saws without one
+
+	// setup
+	void SetEnvelope(float attackSeconds, float releaseSeconds);
+	void SetLevel(float level); // applied to the sum
+
+	// control thread
+	bool PushNote(int note, float velocity); // false if the queue was full
+
+	float GetSample() override;
+	void SetParam(int param, float value) override; // any param sets the level
+	int GetActiveVoices();
+	int GetStolenVoices();
+	int GetDroppedEvents();
+};
\ No newline at end of file
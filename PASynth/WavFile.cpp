@@ -1,19 +1,266 @@
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
 #include "sndfile.h"
 #include "WavFile.h"
 
-std::vector<float>* GetWaveform(std::string filename)
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define READ_BLOCK_FRAMES (65536) // frames per sf_readf_float call
+
+#define WAVE_FORMAT_IEEE_FLOAT (3)
+#define WAVE_FORMAT_EXTENSIBLE (0xFFFE)
+
+// reads the whole file a block at a time, handing each block of interleaved frames to use with its offset in frames
+template <class BlockUser>
+static sf_count_t ReadBlocks(SNDFILE* f, const SF_INFO& sfinfo, BlockUser use)
+{
+	float* block = new float[READ_BLOCK_FRAMES * sfinfo.channels];
+	sf_count_t framesRead = 0;
+	while (framesRead < sfinfo.frames)
+	{
+		sf_count_t want = std::min((sf_count_t)READ_BLOCK_FRAMES, sfinfo.frames - framesRead);
+		sf_count_t got = sf_readf_float(f, block, want);
+		if (got <= 0)
+		{
+			break;
+		}
+		use(block, (int)framesRead, (int)got);
+		framesRead += got;
+	}
+	delete[] block;
+	return framesRead;
+}
+
+static SNDFILE* OpenForReading(std::string filename, SF_INFO* sfinfo)
+{
+	memset(sfinfo, 0, sizeof(*sfinfo));
+	SNDFILE* f = sf_open(filename.c_str(), SFM_READ, sfinfo);
+	if (f == nullptr)
+	{
+		std::cout << "couldn't open " << filename << ": " << sf_strerror(nullptr) << "\n";
+	}
+	return f;
+}
+
+waveTable* GetWaveform(std::string filename)
 {
-	std::vector<float>* waveForm = new std::vector<float>();
+	waveTable* waveForm = new waveTable();
 	SF_INFO sfinfo;
-	memset(&sfinfo, 0, sizeof(sfinfo));
-	SNDFILE* f = sf_open(filename.c_str(), SFM_READ, &sfinfo);
-	int readcount;
-	float data;
+	SNDFILE* f = OpenForReading(filename, &sfinfo);
+	if (f == nullptr)
+	{
+		return waveForm;
+	}
 
-	while ((readcount = (int)sf_read_float(f, &data, 1)))
+	// size the table once from the header, then mix each block down into it
+	int channels = sfinfo.channels;
+	float scale = 1.0f / channels;
+	waveForm->resize((size_t)sfinfo.frames);
+	float* out = waveForm->data();
+	sf_count_t framesRead = ReadBlocks(f, sfinfo, [=](const float* block, int offset, int frames)
 	{
-		waveForm->push_back(data);
-	};
+		for (int i = 0; i < frames; i++)
+		{
+			float sum = 0;
+			for (int c = 0; c < channels; c++)
+			{
+				sum += block[i * channels + c];
+			}
+			out[offset + i] = (channels == 1) ? sum : sum * scale;
+		}
+	});
+	waveForm->resize((size_t)framesRead); // in case the header promised more than the file holds
 
+	sf_close(f);
 	return waveForm;
+}
+
+SampleBuffer* GetSampleBuffer(std::string filename)
+{
+	SF_INFO sfinfo;
+	SNDFILE* f = OpenForReading(filename, &sfinfo);
+	if (f == nullptr)
+	{
+		return new SampleBuffer(1, 0);
+	}
+
+	SampleBuffer* buffer = new SampleBuffer(sfinfo.channels, (int)sfinfo.frames);
+	sf_count_t framesRead = ReadBlocks(f, sfinfo, [=](const float* block, int offset, int frames)
+	{
+		buffer->Deinterleave(block, offset, frames);
+	});
+	buffer->Truncate((int)framesRead); // in case the header promised more than the file holds
+
+	sf_close(f);
+	return buffer;
+}
+
+MappedWaveform::MappedWaveform(std::string filename)
+{
+#ifdef _WIN32
+	HANDLE h = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	file = h;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(h, &fileSize);
+	mapping = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		Unmap();
+		return;
+	}
+	view = MapViewOfFile((HANDLE)mapping, FILE_MAP_READ, 0, 0, 0);
+	viewSize = (size_t)fileSize.QuadPart;
+#else
+	file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		Unmap();
+		return;
+	}
+	viewSize = (size_t)info.st_size;
+	view = mmap(nullptr, viewSize, PROT_READ, MAP_SHARED, file, 0);
+	if (view == MAP_FAILED)
+	{
+		view = nullptr;
+	}
+#endif
+
+	if (view == nullptr || !FindSamples())
+	{
+		Unmap();
+	}
+}
+
+MappedWaveform::~MappedWaveform()
+{
+	Unmap();
+}
+
+static uint32_t ReadLE32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t ReadLE16(const unsigned char* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool MappedWaveform::FindSamples()
+{
+	const unsigned char* bytes = (const unsigned char*)view;
+	if (viewSize < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0)
+	{
+		return false;
+	}
+
+	bool isFloat = false;
+	size_t pos = 12;
+	while (pos + 8 <= viewSize)
+	{
+		const unsigned char* chunk = bytes + pos;
+		size_t chunkSize = ReadLE32(chunk + 4);
+		const unsigned char* body = chunk + 8;
+		size_t available = viewSize - pos - 8;
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && available >= 16)
+		{
+			int format = ReadLE16(body);
+			if (format == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26 && available >= 26)
+			{
+				format = ReadLE16(body + 24); // first two bytes of the subformat GUID
+			}
+			channels = ReadLE16(body + 2);
+			int bits = ReadLE16(body + 14);
+			isFloat = (format == WAVE_FORMAT_IEEE_FLOAT && bits == 32 && channels > 0);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			// the samples are used in place, so they have to be aligned for float reads
+			if (!isFloat || ((uintptr_t)body % sizeof(float)) != 0)
+			{
+				return false;
+			}
+			samples = (const float*)body;
+			size = (int)(std::min(chunkSize, available) / sizeof(float));
+			size -= size % channels;
+			return true;
+		}
+
+		pos += 8 + chunkSize + (chunkSize & 1); // chunks are padded to an even length
+	}
+	return false;
+}
+
+void MappedWaveform::Unmap()
+{
+#ifdef _WIN32
+	if (view != nullptr)
+	{
+		UnmapViewOfFile(view);
+	}
+	if (mapping != nullptr)
+	{
+		CloseHandle((HANDLE)mapping);
+	}
+	if (file != nullptr)
+	{
+		CloseHandle((HANDLE)file);
+	}
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (view != nullptr)
+	{
+		munmap(view, viewSize);
+	}
+	if (file >= 0)
+	{
+		close(file);
+	}
+	file = -1;
+#endif
+	view = nullptr;
+	samples = nullptr;
+	size = 0;
+}
+
+bool MappedWaveform::IsMapped()
+{
+	return samples != nullptr;
+}
+
+const float* MappedWaveform::GetData()
+{
+	return samples;
+}
+
+int MappedWaveform::GetSize()
+{
+	return size;
+}
+
+int MappedWaveform::GetChannels()
+{
+	return channels;
 }
\ No newline at end of file
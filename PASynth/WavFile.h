@@ -1,8 +1,41 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <cstddef>
+#include "WaveTable.h"
 
 
-std::vector<float>* GetWaveform(std::string filename);
+waveTable* GetWaveform(std::string filename); // whole file mixed down to mono
 
-//void SaveWaveform(std::string filename, std::vector<float>* waveform);
\ No newline at end of file
+SampleBuffer* GetSampleBuffer(std::string filename); // whole file, one plane per channel
+
+//void SaveWaveform(std::string filename, waveTable* waveform);
+
+class MappedWaveform // a 32 bit float WAV mapped straight into memory, read only so other processes mapping it share the pages
+{
+private:
+	const float* samples = nullptr;
+	int size = 0; // samples, channels interleaved
+	int channels = 0;
+	void* view = nullptr;
+	size_t viewSize = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+
+	bool FindSamples(); // walks the RIFF chunks for a float fmt and the data chunk
+	void Unmap();
+
+public:
+	MappedWaveform(std::string filename);
+	~MappedWaveform();
+	MappedWaveform(const MappedWaveform&) = delete; // owns the mapping, a copy would unmap it twice
+	MappedWaveform& operator=(const MappedWaveform&) = delete;
+	bool IsMapped(); // false if the file is missing or isn't 32 bit float, load it with GetSampleBuffer instead
+	const float* GetData(); // channels interleaved
+	int GetSize(); // in samples, GetSize() / GetChannels() frames
+	int GetChannels();
+};
\ No newline at end of file
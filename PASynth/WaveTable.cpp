@@ -0,0 +1,172 @@
+#include <iostream>
+#include <map>
+#include <mutex>
+#include "WaveTable.h"
+#include "AudioMath.h"
+
+struct TableKey
+{
+	int shape;
+	int length;
+	int param;
+
+	bool operator<(const TableKey& other) const
+	{
+		if (shape != other.shape) return shape < other.shape;
+		if (length != other.length) return length < other.length;
+		return param < other.param;
+	}
+};
+
+static std::map<TableKey, std::weak_ptr<const waveTable> > sharedTables;
+static std::mutex sharedTablesMutex;
+
+static waveTable* BuildTable(tableShape shape, int length, int param)
+{
+	switch (shape)
+	{
+	case hannTable:
+		return MakeHannTable(length);
+	case sineTable:
+		return MakeSineTable(length);
+	case sawTable:
+		return MakeSawTable(length);
+	case mipmapSineTable:
+		return MakeBandLimitedTable(sineWave, length, 1);
+	case mipmapSawTable:
+		return MakeBandLimitedTable(sawWave, length, param);
+	}
+	return new waveTable();
+}
+
+sharedTable GetSharedTable(tableShape shape, int length, int param)
+{
+	std::lock_guard<std::mutex> lock(sharedTablesMutex);
+	TableKey key = { shape, length, param };
+
+	sharedTable table = sharedTables[key].lock();
+	if (!table)
+	{
+		table = sharedTable(BuildTable(shape, length, param));
+		sharedTables[key] = table;
+	}
+	return table;
+}
+
+SharedTableStats GetSharedTableStats()
+{
+	std::lock_guard<std::mutex> lock(sharedTablesMutex);
+	SharedTableStats stats = { 0, 0, 0, 0 };
+
+	std::map<TableKey, std::weak_ptr<const waveTable> >::iterator i = sharedTables.begin();
+	while (i != sharedTables.end())
+	{
+		sharedTable table = i->second.lock();
+		if (!table)
+		{
+			i = sharedTables.erase(i); // every holder let go, the table is already freed
+			continue;
+		}
+		int holders = (int)table.use_count() - 1; // minus the one taken here
+		size_t bytes = table->capacity() * sizeof(float);
+		stats.tables++;
+		stats.holders += holders;
+		stats.bytes += bytes;
+		if (holders > 1) // the last holder can let go between the lock and use_count
+		{
+			stats.savedBytes += (holders - 1) * bytes;
+		}
+		++i;
+	}
+	return stats;
+}
+
+void PrintSharedTableStats()
+{
+	SharedTableStats stats = GetSharedTableStats();
+	std::cout << "shared tables: " << stats.tables << " tables, " << stats.holders << " holders, "
+		<< stats.bytes / 1024 << " KB held, " << stats.savedBytes / 1024 << " KB saved by sharing\n";
+}
+
+
+/*
+SAMPLE BUFFERS
+*/
+
+SampleBuffer::SampleBuffer(int channels, int frames)
+{
+	this->frames = frames;
+	ownsPlanes = true;
+	for (int c = 0; c < channels; c++)
+	{
+		planes.push_back(new waveTable(frames, 0.0f));
+	}
+}
+
+SampleBuffer::SampleBuffer(waveTable* mono)
+{
+	frames = (int)mono->size();
+	ownsPlanes = false;
+	planes.push_back(mono);
+}
+
+SampleBuffer::~SampleBuffer()
+{
+	if (ownsPlanes)
+	{
+		for (size_t c = 0; c < planes.size(); c++)
+		{
+			delete planes[c];
+		}
+	}
+}
+
+int SampleBuffer::GetChannels()
+{
+	return (int)planes.size();
+}
+
+int SampleBuffer::GetFrames()
+{
+	return frames;
+}
+
+float* SampleBuffer::GetChannel(int channel)
+{
+	return planes[channel]->data();
+}
+
+waveTable* SampleBuffer::GetPlane(int channel)
+{
+	return planes[channel];
+}
+
+void SampleBuffer::Truncate(int frames)
+{
+	if (frames >= this->frames)
+	{
+		return;
+	}
+	this->frames = frames < 0 ? 0 : frames;
+	if (ownsPlanes)
+	{
+		for (size_t c = 0; c < planes.size(); c++)
+		{
+			planes[c]->resize((size_t)this->frames);
+		}
+	}
+}
+
+void SampleBuffer::Deinterleave(const float* interleaved, int offset, int frames)
+{
+	int channels = (int)planes.size();
+	for (int c = 0; c < channels; c++)
+	{
+		float* plane = planes[c]->data() + offset;
+		const float* in = interleaved + c;
+		for (int i = 0; i < frames; i++)
+		{
+			plane[i] = in[i * channels];
+		}
+	}
+}
\ No newline at end of file
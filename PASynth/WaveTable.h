@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#define TABLE_ALIGN (32) // every table starts on a boundary wide enough for AVX loads
+
+template <class T, size_t Align>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+	template <class U> struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+	AlignedAllocator() {}
+	template <class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+	T* allocate(size_t n)
+	{
+		// over-allocate, then keep the real start just before the aligned block
+		char* raw = new char[n * sizeof(T) + Align + sizeof(char*)];
+		size_t aligned = ((size_t)(raw + sizeof(char*)) + Align - 1) & ~(size_t)(Align - 1);
+		((char**)aligned)[-1] = raw;
+		return (T*)aligned;
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		delete[] ((char**)p)[-1];
+	}
+
+	template <class U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+	template <class U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+typedef std::vector<float, AlignedAllocator<float, TABLE_ALIGN> > waveTable;
+
+
+/*
+SAMPLE BUFFERS
+Multichannel audio kept deinterleaved, one aligned waveTable per channel, so each channel can be read
+with straight copies and vector loads.
+*/
+
+class SampleBuffer
+{
+private:
+	std::vector<waveTable*> planes;
+	int frames;
+	bool ownsPlanes;
+
+public:
+	SampleBuffer(int channels, int frames); // silent
+	SampleBuffer(waveTable* mono); // a one channel view of an existing table, which isn't copied or freed
+	~SampleBuffer();
+
+	int GetChannels();
+	int GetFrames();
+	float* GetChannel(int channel);
+	waveTable* GetPlane(int channel);
+	void Deinterleave(const float* interleaved, int offset, int frames); // copy interleaved frames in starting at frame offset
+	void Truncate(int frames); // drop everything past frames, never grows the buffer
+};
+
+
+/*
+SHARED TABLES
+Identical tables are only built once. The registry hands out read only tables keyed by shape, length and
+a shape specific parameter, and frees each one when the last holder lets go of it.
+*/
+
+enum tableShape { hannTable, sineTable, sawTable, mipmapSineTable, mipmapSawTable };
+
+typedef std::shared_ptr<const waveTable> sharedTable;
+
+sharedTable GetSharedTable(tableShape shape, int length, int param = 0);
+
+struct SharedTableStats
+{
+	int tables; // live tables
+	int holders; // references held on them
+	size_t bytes; // memory held by live tables
+	size_t savedBytes; // memory extra holders would have used for private copies
+};
+
+SharedTableStats GetSharedTableStats();
+
+void PrintSharedTableStats();
\ No newline at end of file
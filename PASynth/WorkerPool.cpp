@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <chrono>
+#include "WorkerPool.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+class WakeSemaphore
+{
+private:
+	HANDLE handle;
+
+public:
+	WakeSemaphore() { handle = CreateSemaphore(NULL, 0, MAXLONG, NULL); }
+	~WakeSemaphore() { CloseHandle(handle); }
+	void Post(int count) { ReleaseSemaphore(handle, count, NULL); }
+	void Wait() { WaitForSingleObject(handle, INFINITE); }
+};
+#else
+#include <cerrno>
+#include <semaphore.h>
+
+class WakeSemaphore
+{
+private:
+	sem_t sem;
+
+public:
+	WakeSemaphore() { sem_init(&sem, 0, 0); }
+	~WakeSemaphore() { sem_destroy(&sem); }
+	void Post(int count) { for (int i = 0; i < count; i++) sem_post(&sem); }
+	void Wait() { while (sem_wait(&sem) != 0 && errno == EINTR); }
+};
+#endif
+
+static const uint64_t TASK_MASK = 0xFFFF;
+
+static uint64_t PackClaim(uint64_t generation, uint64_t next, uint64_t count)
+{
+	return (generation << 32) | (next << 16) | count;
+}
+
+WorkerPool::WorkerPool(int workers)
+{
+	this->workers = workers < 1 ? 1 : workers;
+	wake = new WakeSemaphore();
+	quit = false;
+	claim = 0;
+	tasksLeft = 0;
+	loads = new std::atomic<float>[this->workers];
+	for (int i = 0; i < this->workers; i++)
+	{
+		loads[i] = 0;
+	}
+	for (int i = 1; i < this->workers; i++)
+	{
+		threads.push_back(std::thread(&WorkerPool::WorkerLoop, this, i));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	quit.store(true);
+	wake->Post((int)threads.size());
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	delete wake;
+	delete[] loads;
+}
+
+void WorkerPool::WorkerLoop(int worker)
+{
+	while (true)
+	{
+		wake->Wait();
+		if (quit.load())
+		{
+			return;
+		}
+		RunTasks(worker); // a post left over from a Run that finished without us finds nothing to claim
+	}
+}
+
+void WorkerPool::RunTasks(int worker)
+{
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	bool ran = false;
+	double runBudget = 0;
+	uint64_t current = claim.load(std::memory_order_acquire);
+	while (true)
+	{
+		uint64_t next = (current >> 16) & TASK_MASK;
+		if (next >= (current & TASK_MASK))
+		{
+			break;
+		}
+		if (!claim.compare_exchange_weak(current, current + (1 << 16), std::memory_order_acq_rel))
+		{
+			continue;
+		}
+		runBudget = budget;
+		job->RunTask((int)next);
+		ran = true;
+		tasksLeft.fetch_sub(1, std::memory_order_release);
+		current = claim.load(std::memory_order_acquire);
+	}
+	if (ran)
+	{
+		std::chrono::duration<double> busy = std::chrono::steady_clock::now() - begin;
+		loads[worker].store((float)(busy.count() / runBudget), std::memory_order_relaxed);
+	}
+}
+
+void WorkerPool::Run(PoolJob* job, int tasks, double budgetSeconds)
+{
+	tasks = std::max(0, std::min(tasks, (int)TASK_MASK));
+	for (int i = 0; i < workers; i++)
+	{
+		loads[i].store(0, std::memory_order_relaxed);
+	}
+
+	// the previous Run's word is exhausted, so nothing can be claimed while these are rewritten
+	this->job = job;
+	budget = budgetSeconds;
+	tasksLeft.store(tasks, std::memory_order_relaxed);
+	uint64_t generation = (claim.load(std::memory_order_relaxed) >> 32) + 1;
+	claim.store(PackClaim(generation, 0, tasks), std::memory_order_release);
+	if (workers > 1 && tasks > 1)
+	{
+		wake->Post(std::min(workers - 1, tasks - 1));
+	}
+
+	RunTasks(0);
+
+	// every task has been claimed by now, wait only for the ones still running on other threads
+	while (tasksLeft.load(std::memory_order_acquire) > 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+int WorkerPool::GetWorkers()
+{
+	return workers;
+}
+
+float WorkerPool::GetLoad(int worker)
+{
+	if (worker < 0 || worker >= workers)
+	{
+		return 0.0f;
+	}
+	return loads[worker].load(std::memory_order_relaxed);
+}
\ No newline at end of file
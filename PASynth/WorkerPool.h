@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+class PoolJob // work that can be split into independent numbered tasks
+{
+public:
+	virtual ~PoolJob() {}
+	virtual void RunTask(int task) = 0;
+};
+
+class WakeSemaphore; // the platform's counting semaphore, in WorkerPool.cpp
+
+/*
+A fixed set of threads for splitting one block of rendering across cores.
+Run hands out tasks to the workers and the calling thread, and returns when every task is done.
+The calling thread counts as worker 0, so a pool of 1 spawns no threads.
+Run never takes a lock: the job is published through one atomic word and the workers are woken with a semaphore post,
+so the caller only ever waits on tasks somebody has already claimed, never on a worker that hasn't woken up yet.
+*/
+class WorkerPool
+{
+private:
+	std::vector<std::thread> threads;
+	int workers;
+	WakeSemaphore* wake;
+	std::atomic<bool> quit;
+
+	// generation in the top 32 bits, the next task to claim and the task count in 16 bits each,
+	// so a worker that wakes late can never claim a task against another Run's count
+	std::atomic<uint64_t> claim;
+	std::atomic<int> tasksLeft; // claimed or not, tasks of the current Run that haven't finished
+
+	PoolJob* job = nullptr; // only read after a successful claim, it can't change until that task finishes
+	double budget = 0; // seconds the caller has for the current Run
+	std::atomic<float>* loads; // per worker busy time over budget for the last Run it took part in
+
+	void WorkerLoop(int worker);
+	void RunTasks(int worker);
+
+public:
+	WorkerPool(int workers);
+	~WorkerPool();
+	void Run(PoolJob* job, int tasks, double budgetSeconds); // tasks is at most 65535
+	int GetWorkers();
+	float GetLoad(int worker); // safe to call from any thread
+};
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+Render speed of every AudioMath node, one row per node and configuration.
+Each sound is pulled through Process in MAX_BLOCK_SIZE blocks, the same way the stream callback pulls it,
+after one warm up block so tables and grain pools are already touched.
+SRand is timed per value drawn rather than per sample.
+-mavx2 builds the same AVX2 kernels the VS project does, leave it off to time the SSE2 ones.
+
+g++ -std=c++14 -O2 -mavx2 -I.. NodeBench.cpp ../AudioMath.cpp ../Biquad.cpp ../GrainCloud.cpp ../VoiceManager.cpp ../WaveTable.cpp ../WorkerPool.cpp -lpthread -o NodeBench
+./NodeBench [frames] [csv|json]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AudioMath.h"
+#include "Biquad.h"
+#include "GrainCloud.h"
+#include "VoiceManager.h"
+
+struct Result
+{
+	std::string node;
+	std::string config;
+	long long samples;
+	double seconds;
+};
+
+static std::vector<Result> results;
+static volatile float sink; // keeps the optimizer from dropping the work
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Add(std::string node, std::string config, long long samples, double seconds)
+{
+	Result result = { node, config, samples, seconds };
+	results.push_back(result);
+}
+
+static void TimeSound(std::string node, std::string config, BaseSound* sound, long long frames, int blockSize = MAX_BLOCK_SIZE)
+{
+	float block[MAX_BLOCK_SIZE];
+	sound->Process(block, blockSize);
+
+	float sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long long done = 0; done < frames; done += blockSize)
+	{
+		int n = (int)std::min((long long)blockSize, frames - done);
+		sound->Process(block, n);
+		sum += block[0];
+	}
+	Add(node, config, frames, Seconds(start));
+	sink = sum;
+}
+
+static void TimeGrains(SampleBuffer* source, int grains, int length, long long frames)
+{
+	waveTable* window = MakeHannTable(length);
+	std::vector<Grain*> pool;
+	for (int g = 0; g < grains; g++)
+	{
+		int start = (g * 7919) % (source->GetFrames() - length);
+		pool.push_back(new Grain(source, start, start + length, 1.0f, g * length / grains, window));
+	}
+
+	float block[MAX_BLOCK_SIZE];
+	float* planes[1] = { block };
+	int grainCount[MAX_BLOCK_SIZE];
+	float sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long long done = 0; done < frames; done += MAX_BLOCK_SIZE)
+	{
+		int n = (int)std::min((long long)MAX_BLOCK_SIZE, frames - done);
+		memset(block, 0, n * sizeof(float));
+		memset(grainCount, 0, n * sizeof(int));
+		for (int g = 0; g < grains; g++)
+		{
+			Grain* grain = pool[g];
+			if (!grain->IsPlaying()) // straight back in, so the number sounding stays fixed
+			{
+				int from = (g * 7919 + (int)done) % (source->GetFrames() - length);
+				grain->UpdateParams(from, from + length, 1.0f, 0);
+				grain->Play();
+			}
+			grain->Render(planes, 1, grainCount, n);
+		}
+		sum += block[0];
+	}
+	Add("Grain", "grains=" + std::to_string(grains) + " length=" + std::to_string(length), frames, Seconds(start));
+	sink = sum;
+}
+
+static void TimeRand(long long values)
+{
+	SRand* rand = new SRand(0, 1015, 1996, .2, 1);
+	double sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long long i = 0; i < values; i++)
+	{
+		sum += rand->GetVal();
+	}
+	Add("SRand", "GetVal tight=0.2", values, Seconds(start));
+
+	double batch[MAX_BLOCK_SIZE];
+	start = std::chrono::steady_clock::now();
+	for (long long done = 0; done < values; done += MAX_BLOCK_SIZE)
+	{
+		int n = (int)std::min((long long)MAX_BLOCK_SIZE, values - done);
+		rand->Fill(batch, n);
+		sum += batch[0];
+	}
+	Add("SRand", "Fill tight=0.2", values, Seconds(start));
+	sink = (float)sum;
+	delete rand;
+}
+
+static void TimeBank(int voices, long long frames) // samples counts every voice, so ns/sample is per voice
+{
+	BiquadBank* bank = new BiquadBank(voices);
+	waveTable input(MAX_BLOCK_SIZE);
+	for (int i = 0; i < MAX_BLOCK_SIZE; i++)
+	{
+		input[i] = (float)((i * 17) % 64) / 32.0f - 1.0f;
+	}
+	std::vector<waveTable> planeData(voices, waveTable(MAX_BLOCK_SIZE));
+	std::vector<float*> planes(voices);
+	for (int v = 0; v < voices; v++)
+	{
+		bank->SetFilter(v, (filterType)(v % 7), 200.0f + 50.0f * v, 2.0f, 6.0f);
+		planes[v] = planeData[v].data();
+	}
+
+	float sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long long done = 0; done < frames; done += MAX_BLOCK_SIZE)
+	{
+		int n = (int)std::min((long long)MAX_BLOCK_SIZE, frames - done);
+		for (int v = 0; v < voices; v++) // fresh input each block, filtering the last output again would run away
+		{
+			memcpy(planes[v], input.data(), n * sizeof(float));
+		}
+		bank->Process(planes.data(), voices, n);
+		sum += planes[0][0];
+	}
+	Add("BiquadBank", "voices=" + std::to_string(voices), frames * voices, Seconds(start));
+	sink = sum;
+}
+
+static void PrintCsv()
+{
+	printf("node, config, samples, seconds, ns/sample, samples/s\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		Result& r = results[i];
+		printf("%s, %s, %lld, %.6f, %.3f, %.0f\n", r.node.c_str(), r.config.c_str(), r.samples, r.seconds,
+			r.seconds * 1e9 / r.samples, r.samples / r.seconds);
+	}
+}
+
+static void PrintJson()
+{
+	printf("[\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		Result& r = results[i];
+		printf("  {\"node\": \"%s\", \"config\": \"%s\", \"samples\": %lld, \"seconds\": %.6f, \"ns_per_sample\": %.3f, \"samples_per_second\": %.0f}%s\n",
+			r.node.c_str(), r.config.c_str(), r.samples, r.seconds, r.seconds * 1e9 / r.samples, r.samples / r.seconds,
+			(i + 1 < results.size()) ? "," : "");
+	}
+	printf("]\n");
+}
+
+int main(int argc, char** argv)
+{
+	long long frames = (argc > 1) ? atoll(argv[1]) : 48000 * 20;
+	bool json = (argc > 2) && strcmp(argv[2], "json") == 0;
+
+	int tableSizes[] = { 512, 4096, 65536 };
+	for (int s = 0; s < 3; s++)
+	{
+		std::string config = "table=" + std::to_string(tableSizes[s]);
+		TimeSound("Sine", config, new Sine(440.0f, 0.5f, tableSizes[s], 0.0f), frames);
+		TimeSound("Saw", config, new Saw(440.0f, 0.5f, tableSizes[s], 0.0f), frames);
+	}
+
+	int sourceSizes[] = { 4096, 1 << 20 };
+	for (int s = 0; s < 2; s++)
+	{
+		TimeSound("WavePlayer", "table=" + std::to_string(sourceSizes[s]), new WavePlayer(MakeNoiseTable(sourceSizes[s])), frames);
+	}
+
+	waveTable* sourceWave = MakeNoiseTable(48000 * 10);
+	SampleBuffer* source = new SampleBuffer(sourceWave);
+	int grainCounts[] = { 1, 16, 64, 256 };
+	for (int g = 0; g < 4; g++)
+	{
+		TimeGrains(source, grainCounts[g], 4800, frames);
+	}
+
+	// wait is chosen so the pool settles at about the grain count asked for
+	int length = 4800;
+	for (int g = 1; g < 4; g++)
+	{
+		int grains = grainCounts[g];
+		std::string config = "grains=" + std::to_string(grains) + " length=" + std::to_string(length);
+		TimeSound("GranularSynth", config,
+			new GranularSynth(source, 10000, 10000 + length, 1.0f, length / grains, GranularSynth::windowType::hann, grains), frames);
+
+		SRand* startRand = new SRand(0, 10000, 40000, .2);
+		SRand* delayRand = new SRand(0, length / grains, 2 * length / grains, 0.5);
+		SRand* rateRand = new SRand(-0.01, 0, 0.1, 2);
+		TimeSound("SGranSynth", config,
+			new SGranSynth(source, 10000, 10000 + length, 1.0f, length / grains, GranularSynth::windowType::hann, startRand, delayRand, rateRand, grains), frames);
+
+		WavePlayer* startPlayer = new WavePlayer(MakeLineTable(10000, 40000, 48000 * 5));
+		WavePlayer* lengthPlayer = new WavePlayer(MakeLineTable((float)length, (float)length, 1024));
+		WavePlayer* densityPlayer = new WavePlayer(MakeLineTable((float)(length / grains), (float)(length / grains), 1024));
+		TimeSound("MovingGranularSynth", config,
+			new MovingGranularSynth(source, startPlayer, lengthPlayer, densityPlayer, GranularSynth::windowType::hann, grains), frames);
+	}
+
+	// GrainCloud is for clouds far denser than a Grain pool, so it goes on into the thousands
+	int cloudCounts[] = { 16, 64, 240, 960, 4800 }; // each divides length, so the wait is exact
+	for (int g = 0; g < 5; g++)
+	{
+		int wait = length / cloudCounts[g];
+		int grains = length / wait;
+		TimeSound("GrainCloud", "grains=" + std::to_string(grains) + " length=" + std::to_string(length),
+			new GrainCloud(sourceWave, 10000, 10000 + length, 1.0f, wait, grains + MAX_BLOCK_SIZE / wait + 1), frames);
+	}
+
+	TimeSound("SimpleLP", "order=1", new SimpleLP(new WavePlayer(sourceWave)), frames);
+	TimeSound("SimpleHP", "order=1", new SimpleHP(new WavePlayer(sourceWave)), frames);
+	int orders[] = { 8, 32, 128 };
+	for (int o = 0; o < 3; o++)
+	{
+		waveTable* coefs = MakeLineTable(1.0f / orders[o], 1.0f / orders[o], orders[o] + 1); // the current input plus order past outputs
+		TimeSound("SimpleFir", "order=" + std::to_string(orders[o]), new SimpleFir(new WavePlayer(sourceWave), orders[o], coefs), frames);
+	}
+
+	const char* filterNames[] = { "lowpass", "highpass", "bandpass", "notch", "lowshelf", "highshelf", "peak" };
+	for (int t = 0; t < 7; t++)
+	{
+		TimeSound("BiquadFilter", filterNames[t], new BiquadFilter(new WavePlayer(sourceWave), (filterType)t, 1000.0f, 2.0f, 6.0f), frames);
+	}
+	int bankVoices[] = { 1, 8, 64, 256 };
+	for (int v = 0; v < 4; v++)
+	{
+		TimeBank(bankVoices[v], frames / 8);
+	}
+
+	// every voice held, in the 32 frame blocks the stream callback asks for
+	int voiceCounts[] = { 16, 64, 256 };
+	for (int v = 0; v < 3; v++)
+	{
+		VoiceManager* sines = new VoiceManager(sineVoice, voiceCounts[v]);
+		VoiceManager* saws = new VoiceManager(sawVoice, voiceCounts[v]);
+		for (int note = 0; note < voiceCounts[v]; note++)
+		{
+			sines->PushNote(note, 0.5f);
+			saws->PushNote(note, 0.5f);
+		}
+		TimeSound("VoiceManager", "sine voices=" + std::to_string(voiceCounts[v]) + " block=32", sines, frames / 4, 32);
+		TimeSound("VoiceManager", "saw voices=" + std::to_string(voiceCounts[v]) + " block=32", saws, frames / 4, 32);
+	}
+
+	TimeRand(frames / 16);
+
+	if (json)
+	{
+		PrintJson();
+	}
+	else
+	{
+		PrintCsv();
+	}
+	return 0;
+}
\ No newline at end of file
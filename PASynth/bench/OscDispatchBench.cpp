@@ -0,0 +1,118 @@
+/*
+Messages per second through OSC address dispatch: a strcmp chain like the old
+ExamplePacketListener, the std::map MessageMappingOscPacketListener used to keep,
+and osc::AddressDispatcher for literal addresses and for wildcard patterns.
+
+g++ -std=c++14 -O2 -I.. OscDispatchBench.cpp ../osc/OscAddressPattern.cpp -o OscDispatchBench
+./OscDispatchBench [addresses] [messages]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "osc/OscAddressDispatcher.h"
+
+struct CstrCompare
+{
+	bool operator()(const char* lhs, const char* rhs) const
+	{
+		return std::strcmp(lhs, rhs) < 0;
+	}
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char* name, int messages, long long hits, double seconds)
+{
+	printf("%s, %d, %lld, %.0f\n", name, messages, hits, messages / seconds);
+}
+
+int main(int argc, char** argv)
+{
+	int addressCount = (argc > 1) ? atoi(argv[1]) : 256;
+	int messages = (argc > 2) ? atoi(argv[2]) : 2000000;
+
+	// /synth/voice<v>/<param> addresses, like a controller driving many voices
+	const char* params[] = { "freq", "amp", "start", "length", "wait", "rate", "cutoff", "q" };
+	std::vector<std::string> addresses;
+	for (int i = 0; i < addressCount; i++)
+	{
+		addresses.push_back("/synth/voice" + std::to_string(i / 8) + "/" + params[i % 8]);
+	}
+
+	std::vector<const char*> incoming(messages);
+	srand(1);
+	for (int i = 0; i < messages; i++)
+	{
+		incoming[i] = addresses[rand() % addressCount].c_str();
+	}
+
+	printf("dispatcher, messages, matches, messages/s\n");
+
+	long long hits = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < messages; i++)
+	{
+		for (int a = 0; a < addressCount; a++)
+		{
+			if (std::strcmp(incoming[i], addresses[a].c_str()) == 0)
+			{
+				hits += a;
+				break;
+			}
+		}
+	}
+	Report("strcmp chain", messages, hits, Seconds(start));
+
+	std::map<const char*, int, CstrCompare> map;
+	for (int a = 0; a < addressCount; a++)
+	{
+		map[addresses[a].c_str()] = a;
+	}
+	hits = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < messages; i++)
+	{
+		std::map<const char*, int, CstrCompare>::iterator found = map.find(incoming[i]);
+		if (found != map.end())
+		{
+			hits += found->second;
+		}
+	}
+	Report("std::map", messages, hits, Seconds(start));
+
+	osc::AddressDispatcher<int> dispatcher;
+	for (int a = 0; a < addressCount; a++)
+	{
+		dispatcher.Add(addresses[a].c_str(), a);
+	}
+	hits = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < messages; i++)
+	{
+		dispatcher.Dispatch(incoming[i], [&](int a) { hits += a; });
+	}
+	Report("AddressDispatcher", messages, hits, Seconds(start));
+
+	// a handful of wildcard patterns repeated, each matching several addresses
+	const char* patterns[] = { "/synth/voice*/freq", "/synth/voice[0-3]/{amp,rate}", "/synth/voice1?/*", "/synth/voice2/?" };
+	int matched = 0;
+	hits = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < messages; i++)
+	{
+		matched += dispatcher.Dispatch(patterns[i & 3], [&](int a) { hits += a; });
+	}
+	Report("AddressDispatcher patterns", messages, hits, Seconds(start));
+	printf("pattern matches per message: %.2f\n", (double)matched / messages);
+
+	return 0;
+}
\ No newline at end of file
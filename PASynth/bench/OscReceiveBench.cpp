@@ -0,0 +1,127 @@
+/*
+Packets per second through SocketReceiveMultiplexer, select backend against epoll/recvmmsg.
+Sender threads blast small OSC messages at loopback sockets for a fixed time and the
+multiplexer parses every packet it receives. Linux only, not part of the Visual Studio project.
+
+g++ -std=c++14 -O2 -I.. OscReceiveBench.cpp ../ip/IpEndpointName.cpp ../ip/posix/UdpSocket.cpp
+	../ip/posix/NetworkingUtils.cpp ../osc/OscTypes.cpp ../osc/OscReceivedElements.cpp
+	../osc/OscOutboundPacketStream.cpp -lpthread -o OscReceiveBench
+./OscReceiveBench [seconds] [sockets]
+*/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "osc/OscOutboundPacketStream.h"
+#include "osc/OscPacketListener.h"
+#include "ip/UdpSocket.h"
+#include "ip/TimerListener.h"
+
+#define BASE_PORT (12100)
+
+class CountingListener : public osc::OscPacketListener
+{
+public:
+	long long messages = 0;
+	long long batches = 0;
+
+	void ProcessPacketBatch(const char* const* data, const int* sizes,
+		const IpEndpointName* remoteEndpoints, int count) override
+	{
+		batches++;
+		osc::OscPacketListener::ProcessPacketBatch(data, sizes, remoteEndpoints, count);
+	}
+
+protected:
+	void ProcessMessage(const osc::ReceivedMessage& m, const IpEndpointName& remoteEndpoint) override
+	{
+		(void)remoteEndpoint;
+		osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
+		float a1, a2, a3;
+		args >> a1 >> a2 >> a3 >> osc::EndMessage;
+		messages++;
+	}
+};
+
+class StopTimer : public TimerListener
+{
+public:
+	SocketReceiveMultiplexer* mux;
+
+	void TimerExpired() override
+	{
+		mux->Break();
+	}
+};
+
+static void Sender(int port, std::atomic<bool>* running, long long* sent)
+{
+	UdpTransmitSocket socket(IpEndpointName("127.0.0.1", port));
+	char buffer[256];
+	long long count = 0;
+	while (*running)
+	{
+		osc::OutboundPacketStream p(buffer, sizeof(buffer));
+		p << osc::BeginMessage("/wek/outputs") << (float)count << 2.0f << 3.0f << osc::EndMessage;
+		socket.Send(p.Data(), p.Size());
+		count++;
+	}
+	*sent = count;
+}
+
+static void RunBackend(ReceiveBackend backend, const char* name, double seconds, int sockets)
+{
+	SocketReceiveMultiplexer mux(backend);
+	CountingListener listener;
+	std::vector<UdpReceiveSocket*> receivers;
+	for (int i = 0; i < sockets; i++)
+	{
+		receivers.push_back(new UdpReceiveSocket(IpEndpointName("127.0.0.1", BASE_PORT + i)));
+		mux.AttachSocketListener(receivers[i], &listener);
+	}
+
+	StopTimer stop;
+	stop.mux = &mux;
+	mux.AttachPeriodicTimerListener((int)(seconds * 1000), &stop);
+
+	std::atomic<bool> running(true);
+	std::vector<long long> sent(sockets, 0);
+	std::vector<std::thread> senders;
+	for (int i = 0; i < sockets; i++)
+	{
+		senders.push_back(std::thread(Sender, BASE_PORT + i, &running, &sent[i]));
+	}
+
+	mux.Run();
+
+	running = false;
+	long long totalSent = 0;
+	for (int i = 0; i < sockets; i++)
+	{
+		senders[i].join();
+		totalSent += sent[i];
+	}
+
+	printf("%s, %d, %.1f, %lld, %lld, %.0f, %.1f\n", name, sockets, seconds, totalSent, listener.messages,
+		listener.messages / seconds, listener.batches ? (double)listener.messages / listener.batches : 1.0);
+
+	for (int i = 0; i < sockets; i++)
+	{
+		mux.DetachSocketListener(receivers[i], &listener);
+		delete receivers[i];
+	}
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 2.0;
+	int sockets = (argc > 2) ? atoi(argv[2]) : 4;
+
+	printf("backend, sockets, seconds, sent, received, received/s, packets per batch\n");
+	RunBackend(SELECT_RECEIVE_BACKEND, "select", seconds, sockets);
+	RunBackend(EPOLL_RECEIVE_BACKEND, "epoll", seconds, sockets);
+	return 0;
+}
\ No newline at end of file
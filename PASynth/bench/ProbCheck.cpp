@@ -0,0 +1,133 @@
+/*
+Checks SRand against prob.c, the rejection sampler it replaced, and times both.
+For each range, draws from prob(), from SRand and from SRand with its table are compared with a two sample
+Kolmogorov-Smirnov test. Any D over the 0.1% critical value fails and the exit code is 1.
+Fill has to give exactly what GetVal does from the same seed, with and without the table, or that fails too.
+Build it a second time with -mavx2 to check the vector table path.
+
+g++ -std=c++14 -O2 -I.. ProbCheck.cpp ../AudioMath.cpp ../WaveTable.cpp ../WorkerPool.cpp ../prob.cpp -lpthread -o ProbCheck
+./ProbCheck [draws]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "AudioMath.h"
+#include "prob.h"
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double KolmogorovSmirnov(std::vector<double> a, std::vector<double> b) // largest gap between the two empirical CDFs
+{
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	size_t i = 0;
+	size_t j = 0;
+	double d = 0;
+	while (i < a.size() && j < b.size())
+	{
+		double x = std::min(a[i], b[j]);
+		while (i < a.size() && a[i] == x)
+		{
+			i++;
+		}
+		while (j < b.size() && b[j] == x)
+		{
+			j++;
+		}
+		d = std::max(d, fabs((double)i / a.size() - (double)j / b.size()));
+	}
+	return d;
+}
+
+static int FillMismatches(SRand* rand, int draws) // values where Fill and GetVal from the same seed disagree at all
+{
+	std::vector<double> filled(draws);
+	rand->SetSeed(4);
+	rand->Fill(filled.data(), draws);
+	rand->SetSeed(4);
+	int mismatches = 0;
+	for (int i = 0; i < draws; i++)
+	{
+		if (filled[i] != rand->GetVal())
+		{
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+	int draws = (argc > 1) ? atoi(argv[1]) : 200000;
+	double critical = 1.949 * sqrt(2.0 / draws); // alpha = 0.001 for two samples of the same size
+
+	// the three from Main.cpp, then one sided, symmetric and steep ranges
+	double ranges[][4] = {
+		{ 0, 1015, 1996, .2 },
+		{ 0, 200, 500, 0.5 },
+		{ -0.01, 0, 0.1, 2 },
+		{ 0, 0, 1, 1 },
+		{ 0, 5, 10, 0.5 },
+		{ 0, 1, 10, 3 },
+	};
+	int rangeCount = sizeof(ranges) / sizeof(ranges[0]);
+
+	printf("low, mid, high, tight, prob ns, GetVal ns, Fill ns, table Fill ns, D, D table, critical, Fill mismatches, table Fill mismatches, result\n");
+	bool passed = true;
+	srrand(12345);
+	for (int r = 0; r < rangeCount; r++)
+	{
+		double* p = ranges[r];
+		std::vector<double> reference(draws);
+		std::vector<double> closed(draws);
+		std::vector<double> filled(draws);
+		std::vector<double> tabled(draws);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < draws; i++)
+		{
+			reference[i] = prob(p[0], p[1], p[2], p[3]);
+		}
+		double probNs = Seconds(start) * 1e9 / draws;
+
+		SRand* rand = new SRand(p[0], p[1], p[2], p[3], 1);
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < draws; i++)
+		{
+			closed[i] = rand->GetVal();
+		}
+		double getValNs = Seconds(start) * 1e9 / draws;
+
+		rand->SetSeed(2);
+		start = std::chrono::steady_clock::now();
+		rand->Fill(filled.data(), draws);
+		double fillNs = Seconds(start) * 1e9 / draws;
+
+		int mismatches = FillMismatches(rand, draws);
+
+		rand->SetSeed(3);
+		rand->EnableTable();
+		start = std::chrono::steady_clock::now();
+		rand->Fill(tabled.data(), draws);
+		double tableNs = Seconds(start) * 1e9 / draws;
+		int tableMismatches = FillMismatches(rand, draws);
+
+		double d = std::max(KolmogorovSmirnov(reference, closed), KolmogorovSmirnov(reference, filled));
+		double dTable = KolmogorovSmirnov(reference, tabled);
+		bool ok = d < critical && dTable < critical && mismatches == 0 && tableMismatches == 0;
+		passed = passed && ok;
+		printf("%g, %g, %g, %g, %.1f, %.1f, %.1f, %.1f, %.5f, %.5f, %.5f, %d, %d, %s\n", p[0], p[1], p[2], p[3],
+			probNs, getValNs, fillNs, tableNs, d, dTable, critical, mismatches, tableMismatches, ok ? "pass" : "FAIL");
+		delete rand;
+	}
+
+	return passed ? 0 : 1;
+}
\ No newline at end of file
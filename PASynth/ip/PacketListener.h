@@ -38,13 +38,22 @@
 #define INCLUDED_OSCPACK_PACKETLISTENER_H
 
 
-class IpEndpointName;
+#include "IpEndpointName.h"
 
 class PacketListener{
 public:
     virtual ~PacketListener() {}
     virtual void ProcessPacket( const char *data, int size, 
 			const IpEndpointName& remoteEndpoint ) = 0;
+
+    // called by receive backends that read several packets at once,
+    // override to amortise per packet work across the batch
+    virtual void ProcessPacketBatch( const char *const *data, const int *sizes,
+			const IpEndpointName *remoteEndpoints, int count )
+    {
+        for( int i = 0; i < count; ++i )
+            ProcessPacket( data[i], sizes[i], remoteEndpoints[i] );
+    }
 };
 
 #endif /* INCLUDED_OSCPACK_PACKETLISTENER_H */
@@ -48,6 +48,15 @@ class TimerListener;
 
 class UdpSocket;
 
+// how SocketReceiveMultiplexer waits for and reads packets.
+// EPOLL_RECEIVE_BACKEND uses epoll and recvmmsg to read and dispatch packets
+// in batches, it is only available on Linux and falls back to select elsewhere.
+enum ReceiveBackend{
+    SELECT_RECEIVE_BACKEND,
+    EPOLL_RECEIVE_BACKEND
+};
+
+
 class SocketReceiveMultiplexer{
     class Implementation;
     Implementation *impl_;
@@ -55,7 +64,8 @@ class SocketReceiveMultiplexer{
 	friend class UdpSocket;
 
 public:
-    SocketReceiveMultiplexer();
+    SocketReceiveMultiplexer(); // select, the only backend the win32 implementation has
+    explicit SocketReceiveMultiplexer( ReceiveBackend backend ); // posix implementation only
     ~SocketReceiveMultiplexer();
 
 	// only call the attach/detach methods _before_ calling Run
@@ -162,6 +172,15 @@ public:
         mux_.AttachSocketListener( this, listener_ );
     }
 
+	UdpListeningReceiveSocket( const IpEndpointName& localEndpoint, PacketListener *listener,
+            ReceiveBackend backend )
+        : mux_( backend )
+        , listener_( listener )
+    {
+        Bind( localEndpoint );
+        mux_.AttachSocketListener( this, listener_ );
+    }
+
     ~UdpListeningReceiveSocket()
         { mux_.DetachSocketListener( this, listener_ ); }
 
@@ -44,8 +44,14 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
 #include <netinet/in.h> // for sockaddr_in
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define OSCPACK_HAVE_EPOLL
+#endif
+
 #include <signal.h>
 #include <math.h>
 #include <errno.h>
@@ -316,12 +322,19 @@ struct AttachedTimerListener{
 };
 
 
+// orders the timer queue as a min-heap on expiry time
 static bool CompareScheduledTimerCalls( 
 		const std::pair< double, AttachedTimerListener > & lhs, const std::pair< double, AttachedTimerListener > & rhs )
 {
-	return lhs.first < rhs.first;
+	return lhs.first > rhs.first;
 }
 
+// expiry time ms, listener. a binary heap, the next timer due is always at the front
+typedef std::vector< std::pair< double, AttachedTimerListener > > TimerQueue;
+
+static const int MAX_BUFFER_SIZE = 4098;
+static const int RECEIVE_BATCH_SIZE = 64; // packets read per recvmmsg call
+
 
 SocketReceiveMultiplexer *multiplexerInstanceToAbortWithSigInt_ = 0;
 
@@ -336,21 +349,86 @@ extern "C" /*static*/ void InterruptSignalHandler( int );
 class SocketReceiveMultiplexer::Implementation{
 	std::vector< std::pair< PacketListener*, UdpSocket* > > socketListeners_;
 	std::vector< AttachedTimerListener > timerListeners_;
+	ReceiveBackend backend_;
 
 	volatile bool break_;
 	int breakPipe_[2]; // [0] is the reader descriptor and [1] the writer
 
+	std::vector< std::pair< double, AttachedTimerListener > > expiredTimers_; // reused by RunExpiredTimers
+
+	// monotonic, so timers don't jump when the wall clock is adjusted
 	double GetCurrentTimeMs() const
 	{
-		struct timeval t;
+		struct timespec t;
+
+		clock_gettime( CLOCK_MONOTONIC, &t );
+
+		return ((double)t.tv_sec*1000.) + ((double)t.tv_nsec / 1000000.);
+	}
+
+	void InitTimerQueue( TimerQueue& timerQueue )
+	{
+		double currentTimeMs = GetCurrentTimeMs();
+		for( std::vector< AttachedTimerListener >::iterator i = timerListeners_.begin();
+				i != timerListeners_.end(); ++i )
+			timerQueue.push_back( std::make_pair( currentTimeMs + i->initialDelayMs, *i ) );
+		std::make_heap( timerQueue.begin(), timerQueue.end(), CompareScheduledTimerCalls );
+		expiredTimers_.reserve( timerQueue.size() );
+	}
+
+	// ms until the next timer is due, negative if there are no timers
+	double NextTimerTimeoutMs( const TimerQueue& timerQueue ) const
+	{
+		if( timerQueue.empty() )
+			return -1.;
+
+		double timeoutMs = timerQueue.front().first - GetCurrentTimeMs();
+		return (timeoutMs < 0) ? 0 : timeoutMs;
+	}
+
+	void RunExpiredTimers( TimerQueue& timerQueue )
+	{
+		double currentTimeMs = GetCurrentTimeMs();
+
+		// take every due timer off the heap first, so each fires at most once per pass
+		// even if its period is shorter than the time it took to get here
+		expiredTimers_.clear();
+		while( !timerQueue.empty() && timerQueue.front().first <= currentTimeMs ){
+			std::pop_heap( timerQueue.begin(), timerQueue.end(), CompareScheduledTimerCalls );
+			expiredTimers_.push_back( timerQueue.back() );
+			timerQueue.pop_back();
+		}
 
-		gettimeofday( &t, 0 );
+		for( std::size_t i = 0; i < expiredTimers_.size(); ++i ){
+			std::pair< double, AttachedTimerListener >& timer = expiredTimers_[i];
 
-		return ((double)t.tv_sec*1000.) + ((double)t.tv_usec / 1000.);
+			if( !break_ )
+				timer.second.listener->TimerExpired();
+
+			// step from when it was due, not when it ran, so the period doesn't drift.
+			// if whole periods were missed, skip them but stay on the same grid
+			double periodMs = timer.second.periodMs;
+			double nextMs = timer.first + periodMs;
+			if( nextMs <= currentTimeMs )
+				nextMs = (periodMs > 0)
+						? timer.first + periodMs * (floor( (currentTimeMs - timer.first) / periodMs ) + 1)
+						: currentTimeMs;
+			timer.first = nextMs;
+
+			timerQueue.push_back( timer );
+			std::push_heap( timerQueue.begin(), timerQueue.end(), CompareScheduledTimerCalls );
+		}
+	}
+
+	void ClearBreakPipe()
+	{
+		char c;
+		read( breakPipe_[0], &c, 1 );
 	}
 
 public:
-    Implementation()
+    Implementation( ReceiveBackend backend )
+		: backend_( backend )
 	{
 		if( pipe(breakPipe_) != 0 )
 			throw std::runtime_error( "creation of asynchronous break pipes failed\n" );
@@ -405,6 +483,17 @@ public:
     void Run()
 	{
 		break_ = false;
+#ifdef OSCPACK_HAVE_EPOLL
+		if( backend_ == EPOLL_RECEIVE_BACKEND ){
+			RunEpoll();
+			return;
+		}
+#endif
+		RunSelect();
+	}
+
+    void RunSelect()
+	{
         char *data = 0;
         
         try{
@@ -431,16 +520,9 @@ public:
 
 
             // configure the timer queue
-            double currentTimeMs = GetCurrentTimeMs();
-
-            // expiry time ms, listener
-            std::vector< std::pair< double, AttachedTimerListener > > timerQueue_;
-            for( std::vector< AttachedTimerListener >::iterator i = timerListeners_.begin();
-                    i != timerListeners_.end(); ++i )
-                timerQueue_.push_back( std::make_pair( currentTimeMs + i->initialDelayMs, *i ) );
-            std::sort( timerQueue_.begin(), timerQueue_.end(), CompareScheduledTimerCalls );
+            TimerQueue timerQueue_;
+            InitTimerQueue( timerQueue_ );
 
-            const int MAX_BUFFER_SIZE = 4098;
             data = new char[ MAX_BUFFER_SIZE ];
             IpEndpointName remoteEndpoint;
 
@@ -450,11 +532,8 @@ public:
                 tempfds = masterfds;
 
                 struct timeval *timeoutPtr = 0;
-                if( !timerQueue_.empty() ){
-                    double timeoutMs = timerQueue_.front().first - GetCurrentTimeMs();
-                    if( timeoutMs < 0 )
-                        timeoutMs = 0;
-                
+                double timeoutMs = NextTimerTimeoutMs( timerQueue_ );
+                if( timeoutMs >= 0 ){
                     long timoutSecondsPart = (long)(timeoutMs * .001);
                     timeout.tv_sec = (time_t)timoutSecondsPart;
                     // 1000000 microseconds in a second
@@ -478,8 +557,7 @@ public:
 
                 if( FD_ISSET( breakPipe_[0], &tempfds ) ){
                     // clear pending data from the asynchronous break pipe
-                    char c;
-                    read( breakPipe_[0], &c, 1 );
+                    ClearBreakPipe();
                 }
                 
                 if( break_ )
@@ -500,29 +578,129 @@ public:
                 }
 
                 // execute any expired timers
-                currentTimeMs = GetCurrentTimeMs();
-                bool resort = false;
-                for( std::vector< std::pair< double, AttachedTimerListener > >::iterator i = timerQueue_.begin();
-                        i != timerQueue_.end() && i->first <= currentTimeMs; ++i ){
+                RunExpiredTimers( timerQueue_ );
+            }
 
-                    i->second.listener->TimerExpired();
-                    if( break_ )
+            delete [] data;
+        }catch(...){
+            if( data )
+                delete [] data;
+            throw;
+        }
+	}
+
+#ifdef OSCPACK_HAVE_EPOLL
+    // epoll tells us which sockets are readable without rebuilding an fd_set each pass,
+    // then each readable socket gives up to RECEIVE_BATCH_SIZE packets per recvmmsg call
+    // and the whole batch is handed to its listener at once.
+    void RunEpoll()
+	{
+        int epollFd = epoll_create1( 0 );
+        if( epollFd < 0 )
+            throw std::runtime_error("epoll_create1 failed\n");
+
+        char *data = 0;
+
+        try{
+            // event data is the index into socketListeners_, or -1 for the asynchronous break pipe
+            struct epoll_event event;
+            std::memset( &event, 0, sizeof(event) );
+            event.events = EPOLLIN;
+            event.data.u64 = (uint64_t)-1;
+            if( epoll_ctl( epollFd, EPOLL_CTL_ADD, breakPipe_[0], &event ) != 0 )
+                throw std::runtime_error("epoll_ctl failed\n");
+
+            for( std::size_t i = 0; i < socketListeners_.size(); ++i ){
+                event.data.u64 = i;
+                if( epoll_ctl( epollFd, EPOLL_CTL_ADD, socketListeners_[i].second->impl_->Socket(), &event ) != 0 )
+                    throw std::runtime_error("epoll_ctl failed\n");
+            }
+
+            TimerQueue timerQueue_;
+            InitTimerQueue( timerQueue_ );
+
+            data = new char[ MAX_BUFFER_SIZE * RECEIVE_BATCH_SIZE ];
+            struct mmsghdr messages[ RECEIVE_BATCH_SIZE ];
+            struct iovec buffers[ RECEIVE_BATCH_SIZE ];
+            struct sockaddr_in fromAddrs[ RECEIVE_BATCH_SIZE ];
+            const char *packetData[ RECEIVE_BATCH_SIZE ];
+            int packetSizes[ RECEIVE_BATCH_SIZE ];
+            IpEndpointName remoteEndpoints[ RECEIVE_BATCH_SIZE ];
+
+            std::memset( messages, 0, sizeof(messages) );
+            for( int i = 0; i < RECEIVE_BATCH_SIZE; ++i ){
+                buffers[i].iov_base = data + i * MAX_BUFFER_SIZE;
+                buffers[i].iov_len = MAX_BUFFER_SIZE;
+                messages[i].msg_hdr.msg_iov = &buffers[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+                messages[i].msg_hdr.msg_name = &fromAddrs[i];
+            }
+
+            const int MAX_EVENTS = 32;
+            struct epoll_event events[ MAX_EVENTS ];
+
+            while( !break_ ){
+                int timeout = -1;
+                double timeoutMs = NextTimerTimeoutMs( timerQueue_ );
+                if( timeoutMs >= 0 )
+                    timeout = (int)ceil( timeoutMs ); // rounding down would wake early and spin
+
+                int eventCount = epoll_wait( epollFd, events, MAX_EVENTS, timeout );
+                if( eventCount < 0 ){
+                    if( break_ ){
                         break;
+                    }else if( errno == EINTR ){
+                        continue;
+                    }else{
+                        throw std::runtime_error("epoll_wait failed\n");
+                    }
+                }
 
-                    i->first += i->second.periodMs;
-                    resort = true;
+                for( int e = 0; e < eventCount && !break_; ++e ){
+                    if( events[e].data.u64 == (uint64_t)-1 ){
+                        ClearBreakPipe();
+                        continue;
+                    }
+
+                    std::pair< PacketListener*, UdpSocket* >& socketListener = socketListeners_[ events[e].data.u64 ];
+                    int socket = socketListener.second->impl_->Socket();
+
+                    // one batch per wakeup, epoll is level triggered so a socket with more
+                    // waiting comes straight back without starving the others or the timers
+                    for( int i = 0; i < RECEIVE_BATCH_SIZE; ++i )
+                        messages[i].msg_hdr.msg_namelen = sizeof(fromAddrs[i]);
+
+                    int received = recvmmsg( socket, messages, RECEIVE_BATCH_SIZE, MSG_DONTWAIT, 0 );
+                    int count = 0;
+                    for( int i = 0; i < received; ++i ){
+                        if( messages[i].msg_len == 0 )
+                            continue;
+                        packetData[count] = (const char*)buffers[i].iov_base;
+                        packetSizes[count] = (int)messages[i].msg_len;
+                        remoteEndpoints[count].address = ntohl( fromAddrs[i].sin_addr.s_addr );
+                        remoteEndpoints[count].port = ntohs( fromAddrs[i].sin_port );
+                        ++count;
+                    }
+                    if( count > 0 )
+                        socketListener.first->ProcessPacketBatch( packetData, packetSizes, remoteEndpoints, count );
                 }
-                if( resort )
-                    std::sort( timerQueue_.begin(), timerQueue_.end(), CompareScheduledTimerCalls );
+
+                if( break_ )
+                    break;
+
+                RunExpiredTimers( timerQueue_ );
             }
 
             delete [] data;
+            close( epollFd );
         }catch(...){
             if( data )
                 delete [] data;
+            close( epollFd );
             throw;
         }
 	}
+#endif
 
     void Break()
 	{
@@ -542,7 +720,12 @@ public:
 
 SocketReceiveMultiplexer::SocketReceiveMultiplexer()
 {
-	impl_ = new Implementation();
+	impl_ = new Implementation( SELECT_RECEIVE_BACKEND );
+}
+
+SocketReceiveMultiplexer::SocketReceiveMultiplexer( ReceiveBackend backend )
+{
+	impl_ = new Implementation( backend );
 }
 
 SocketReceiveMultiplexer::~SocketReceiveMultiplexer()
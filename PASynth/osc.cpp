@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cstring>
+#include <vector>
+#include <math.h>
 
 #if defined(__BORLANDC__) // workaround for BCB4 release build intrinsics bug
 namespace std {
@@ -9,36 +11,82 @@ namespace std {
 
 #include "osc/OscReceivedElements.h"
 #include "osc/OscPacketListener.h"
+#include "osc/OscOutboundPacketStream.h"
 #include "ip/UdpSocket.h"
 #include "osc.h"
 
 
 
 
+ExamplePacketListener::ExamplePacketListener(ParamBridge* params, VoiceManager* voices)
+    {
+        this->params = params;
+        this->voices = voices;
+    }
+
+// note numbers and velocities come as int32 (MIDI style, velocity 0 to 127) or float (velocity 0 to 1)
+static float NumericArgument(osc::ReceivedMessage::const_iterator arg, float intScale)
+    {
+        if (arg->IsInt32())
+            return arg->AsInt32Unchecked() * intScale;
+        if (arg->IsFloat())
+            return arg->AsFloatUnchecked();
+        if (arg->IsDouble())
+            return (float)arg->AsDoubleUnchecked();
+        throw osc::WrongArgumentTypeException();
+    }
+
+void ExamplePacketListener::ProcessBundle(const osc::ReceivedBundle& b,
+        const IpEndpointName& remoteEndpoint)
+    {
+        // messages inside take the bundle's timetag, nested bundles override it until they finish
+        osc::uint64 outerTag = timeTag;
+        timeTag = b.TimeTag();
+        osc::OscPacketListener::ProcessBundle(b, remoteEndpoint);
+        timeTag = outerTag;
+    }
+
 void ExamplePacketListener::ProcessMessage(const osc::ReceivedMessage& m,
         const IpEndpointName& remoteEndpoint)
     {
         (void)remoteEndpoint; // suppress unused parameter warning
 
         try {
-            // example of parsing single messages. osc::OsckPacketListener
-            // handles the bundle traversal.
-
-            if (std::strcmp(m.AddressPattern(), "/wek/outputs") == 0) {
-                // example #1 -- argument stream interface
-                osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
-                float a1;
-                float a2;
-                float a3;
-                args >> a1 >> a2 >> a3 >> osc::EndMessage;
-                storedMessage[0] = a1;
-                storedMessage[1] = a2;
-                storedMessage[2] = a3;
-                // std::cout << "received '/wek/inputs' message in osc handler with arguments: " << storedMessage[0] << " " << storedMessage[1] << " " << storedMessage[2] << "\n";
-
-                
-
+            if (voices != nullptr) {
+                bool noteOn = std::strcmp(m.AddressPattern(), "/note/on") == 0;
+                if (noteOn || std::strcmp(m.AddressPattern(), "/note/off") == 0) {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    if (arg == m.ArgumentsEnd())
+                        throw osc::MissingArgumentException();
+                    int note = (int)lroundf(NumericArgument(arg++, 1.0f));
+                    float velocity = 0.0f; // note off, or note on with velocity 0 as in MIDI
+                    if (noteOn)
+                        velocity = (arg != m.ArgumentsEnd()) ? NumericArgument(arg, 1.0f / 127.0f) : 1.0f;
+                    voices->PushNote(note, velocity);
+                    return;
+                }
             }
+
+            // every numeric argument with a binding becomes a parameter update,
+            // applied on the frame the bundle timetag names, or at the start of the next block.
+            // a pattern with wildcards updates every bound address it matches
+            long long frame = params->FrameAt(timeTag);
+            params->Dispatch(m.AddressPattern(), [&](const std::vector<int>& bindings) {
+                int argument = 0;
+                for (osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                        arg != m.ArgumentsEnd() && argument < (int)bindings.size(); ++arg, ++argument) {
+                    int id = bindings[argument];
+                    if (id < 0)
+                        continue;
+
+                    if (arg->IsFloat())
+                        params->Push(id, arg->AsFloatUnchecked(), frame);
+                    else if (arg->IsInt32())
+                        params->Push(id, (float)arg->AsInt32Unchecked(), frame);
+                    else if (arg->IsDouble())
+                        params->Push(id, (float)arg->AsDoubleUnchecked(), frame);
+                }
+            });
         }
         catch (osc::Exception& e) {
             // any parsing errors such as unexpected argument types, or 
@@ -46,4 +94,37 @@ void ExamplePacketListener::ProcessMessage(const osc::ReceivedMessage& m,
             std::cout << "error while parsing message: "
                 << m.AddressPattern() << ": " << e.what() << "\n";
         }
+    }
+
+void SendCallbackStats(UdpTransmitSocket& socket, const CallbackStats& stats)
+    {
+        // counts go out as int32, most OSC receivers don't take int64
+        char buffer[OSC_STATS_BUFFER_SIZE];
+        osc::OutboundPacketStream p(buffer, OSC_STATS_BUFFER_SIZE);
+
+        p << osc::BeginBundleImmediate
+            << osc::BeginMessage("/pasynth/callback")
+            << (osc::int32)stats.callbacks << (osc::int32)stats.overruns
+            << (osc::int32)stats.outputUnderflows << (osc::int32)stats.outputOverflows
+            << (float)stats.lastMs << (float)stats.meanMs << (float)stats.maxMs << (float)stats.deadlineMs
+            << osc::EndMessage
+            << osc::BeginMessage("/pasynth/callback/load");
+        for (int b = 0; b < LOAD_BUCKETS; b++)
+            p << (osc::int32)stats.loadHistogram[b];
+        p << osc::EndMessage << osc::EndBundle;
+
+        socket.Send(p.Data(), p.Size());
+    }
+
+void SendMeterStats(UdpTransmitSocket& socket, const MeterStats& stats)
+    {
+        char buffer[OSC_STATS_BUFFER_SIZE];
+        osc::OutboundPacketStream p(buffer, OSC_STATS_BUFFER_SIZE);
+
+        p << osc::BeginMessage("/pasynth/meter");
+        for (int c = 0; c < stats.channels; c++)
+            p << stats.peak[c] << (osc::int32)stats.clippedSamples[c];
+        p << stats.minGain << osc::EndMessage;
+
+        socket.Send(p.Data(), p.Size());
     }
\ No newline at end of file
@@ -3,6 +3,12 @@
 #include "osc/OscPacketListener.h"
 #include "ip/UdpSocket.h"
 #include "AudioMath.h"
+#include "ParamBridge.h"
+#include "CallbackMonitor.h"
+#include "OutputMeter.h"
+#include "VoiceManager.h"
+
+#define OSC_STATS_BUFFER_SIZE (512)
 
 
 
@@ -10,9 +16,23 @@ class ExamplePacketListener : public osc::OscPacketListener {
 
 protected:
 
+    virtual void ProcessBundle(const osc::ReceivedBundle& b,
+        const IpEndpointName& remoteEndpoint);
+
     virtual void ProcessMessage(const osc::ReceivedMessage& m,
         const IpEndpointName& remoteEndpoint);
 
 public:
-    float* storedMessage = new float[3];
-};
\ No newline at end of file
+    ExamplePacketListener(ParamBridge* params, VoiceManager* voices = nullptr);
+
+private:
+    ParamBridge* params; // numeric arguments of bound addresses are forwarded here
+    VoiceManager* voices; // plays /note/on note velocity and /note/off note, if set
+    osc::uint64 timeTag = 1; // of the innermost bundle being processed, 1 means immediately
+};
+
+// sends a snapshot as /pasynth/callback (counts and times in ms) and /pasynth/callback/load (the histogram)
+void SendCallbackStats(UdpTransmitSocket& socket, const CallbackStats& stats);
+
+// sends a meter report as /pasynth/meter, a peak and clip count per channel then the limiter's lowest gain
+void SendMeterStats(UdpTransmitSocket& socket, const MeterStats& stats);
\ No newline at end of file
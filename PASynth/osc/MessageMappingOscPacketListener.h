@@ -37,10 +37,8 @@
 #ifndef INCLUDED_OSCPACK_MESSAGEMAPPINGOSCPACKETLISTENER_H
 #define INCLUDED_OSCPACK_MESSAGEMAPPINGOSCPACKETLISTENER_H
 
-#include <cstring>
-#include <map>
-
 #include "OscPacketListener.h"
+#include "OscAddressDispatcher.h"
 
 
 
@@ -54,25 +52,20 @@ public:
 protected:
     void RegisterMessageFunction( const char *addressPattern, function_type f )
     {
-        functions_.insert( std::make_pair( addressPattern, f ) );
+        functions_.Add( addressPattern, f );
     }
 
+    // the message goes to every registered function its address pattern matches
     virtual void ProcessMessage( const osc::ReceivedMessage& m,
 		const IpEndpointName& remoteEndpoint )
     {
-        typename function_map_type::iterator i = functions_.find( m.AddressPattern() );
-        if( i != functions_.end() )
-            (dynamic_cast<T*>(this)->*(i->second))( m, remoteEndpoint );
+        T *listener = dynamic_cast<T*>(this);
+        functions_.Dispatch( m.AddressPattern(),
+                [&]( function_type f ){ (listener->*f)( m, remoteEndpoint ); } );
     }
     
 private:
-    struct cstr_compare{
-        bool operator()( const char *lhs, const char *rhs ) const
-            { return std::strcmp( lhs, rhs ) < 0; }
-    };
-
-    typedef std::map<const char*, function_type, cstr_compare> function_map_type;
-    function_map_type functions_;
+    AddressDispatcher<function_type> functions_;
 };
 
 } // namespace osc
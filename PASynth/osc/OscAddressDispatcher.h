@@ -0,0 +1,142 @@
+#ifndef INCLUDED_OSCPACK_OSCADDRESSDISPATCHER_H
+#define INCLUDED_OSCPACK_OSCADDRESSDISPATCHER_H
+
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "OscAddressPattern.h"
+
+
+namespace osc{
+
+/*
+    Maps OSC addresses to values of type T.
+    Literal addresses are found with one hash probe into an open addressed table,
+    so the cost doesn't grow with the number of registered addresses.
+    Incoming patterns with wildcards are compiled and matched against every address
+    once, then the matching set is cached, since controllers repeat the same patterns.
+    Add addresses before dispatching starts.
+*/
+template< class T >
+class AddressDispatcher{
+public:
+    AddressDispatcher()
+        : mask_( 0 ) {}
+
+    // returns false, leaving the existing value, if the address is already registered
+    bool Add( const char *address, const T& value )
+    {
+        if( Find( address ) )
+            return false;
+
+        Entry entry;
+        entry.address = address;
+        entry.hash = Hash( address );
+        entry.value = value;
+        entries_.push_back( entry );
+        patternCache_.clear();
+
+        Rehash();
+        return true;
+    }
+
+    // literal lookup, 0 if the address isn't registered
+    T* Find( const char *address )
+    {
+        if( entries_.empty() )
+            return 0;
+
+        unsigned long hash = Hash( address );
+        for( std::size_t slot = hash & mask_; table_[slot] >= 0; slot = (slot + 1) & mask_ ){
+            Entry& entry = entries_[ table_[slot] ];
+            if( entry.hash == hash && std::strcmp( entry.address.c_str(), address ) == 0 )
+                return &entry.value;
+        }
+        return 0;
+    }
+
+    // calls f( value ) for every address the pattern names, returns how many matched
+    template< class F >
+    int Dispatch( const char *addressPattern, F f )
+    {
+        if( !AddressPattern::IsPattern( addressPattern ) ){
+            T *value = Find( addressPattern );
+            if( !value )
+                return 0;
+            f( *value );
+            return 1;
+        }
+
+        typename pattern_cache_type::iterator cached = patternCache_.find( addressPattern );
+        if( cached == patternCache_.end() ){
+            if( patternCache_.size() >= MAX_CACHED_PATTERNS )
+                patternCache_.clear();
+
+            AddressPattern pattern( addressPattern );
+            std::vector< int > matches;
+            for( std::size_t i = 0; i < entries_.size(); ++i ){
+                if( pattern.Matches( entries_[i].address.c_str() ) )
+                    matches.push_back( (int)i );
+            }
+            cached = patternCache_.insert( std::make_pair( std::string( addressPattern ), matches ) ).first;
+        }
+
+        const std::vector< int >& matches = cached->second;
+        for( std::size_t i = 0; i < matches.size(); ++i )
+            f( entries_[ matches[i] ].value );
+        return (int)matches.size();
+    }
+
+    std::size_t Size() const { return entries_.size(); }
+
+private:
+    enum { MAX_CACHED_PATTERNS = 1024 };
+
+    struct Entry{
+        std::string address;
+        unsigned long hash;
+        T value;
+    };
+
+    // std::less<> compares a const char* against the keys, so a cache hit doesn't build a string
+    typedef std::map< std::string, std::vector< int >, std::less<> > pattern_cache_type;
+
+    std::vector< Entry > entries_;
+    std::vector< int > table_; // entry index per slot, -1 if empty. kept at most half full
+    std::size_t mask_;
+    pattern_cache_type patternCache_;
+
+    // FNV-1a
+    static unsigned long Hash( const char *s )
+    {
+        unsigned long hash = 2166136261UL;
+        while( *s ){
+            hash ^= (unsigned char)*s++;
+            hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+        }
+        return hash;
+    }
+
+    void Rehash()
+    {
+        std::size_t size = 16;
+        while( size < entries_.size() * 2 )
+            size *= 2;
+
+        table_.assign( size, -1 );
+        mask_ = size - 1;
+        for( std::size_t i = 0; i < entries_.size(); ++i ){
+            std::size_t slot = entries_[i].hash & mask_;
+            while( table_[slot] >= 0 )
+                slot = (slot + 1) & mask_;
+            table_[slot] = (int)i;
+        }
+    }
+};
+
+} // namespace osc
+
+#endif /* INCLUDED_OSCPACK_OSCADDRESSDISPATCHER_H */
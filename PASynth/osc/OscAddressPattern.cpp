@@ -0,0 +1,147 @@
+#include "OscAddressPattern.h"
+
+#include <cstring>
+
+
+namespace osc{
+
+AddressPattern::AddressPattern( const char *pattern )
+{
+    const char *p = pattern;
+    while( *p ){
+        Token token;
+
+        switch( *p ){
+        case '?':
+            token.type = ANY_CHAR_TOKEN;
+            ++p;
+            break;
+
+        case '*':
+            token.type = ANY_RUN_TOKEN;
+            while( *p == '*' ) // consecutive stars match the same as one
+                ++p;
+            break;
+
+        case '[':{
+            token.type = CHAR_SET_TOKEN;
+            ++p;
+            bool negate = false;
+            if( *p == '!' ){
+                negate = true;
+                ++p;
+            }
+            while( *p && *p != ']' ){
+                // a '-' between two characters is a range, at either end it's literal
+                if( p[1] == '-' && p[2] && p[2] != ']' ){
+                    for( int c = (unsigned char)p[0]; c <= (unsigned char)p[2]; ++c )
+                        token.charSet.set( c );
+                    p += 3;
+                }else{
+                    token.charSet.set( (unsigned char)*p );
+                    ++p;
+                }
+            }
+            if( *p == ']' )
+                ++p;
+            if( negate )
+                token.charSet.flip();
+            token.charSet.reset( '/' );
+            token.charSet.reset( 0 );
+            break;
+        }
+
+        case '{':{
+            token.type = ALTERNATIVES_TOKEN;
+            ++p;
+            std::string alternative;
+            while( *p && *p != '}' ){
+                if( *p == ',' ){
+                    token.alternatives.push_back( alternative );
+                    alternative.clear();
+                }else{
+                    alternative += *p;
+                }
+                ++p;
+            }
+            token.alternatives.push_back( alternative );
+            if( *p == '}' )
+                ++p;
+            break;
+        }
+
+        default:
+            token.type = LITERAL_TOKEN;
+            while( *p && !std::strchr( "?*[{", *p ) ){
+                token.literal += *p;
+                ++p;
+            }
+            break;
+        }
+
+        tokens_.push_back( token );
+    }
+}
+
+
+bool AddressPattern::IsPattern( const char *address )
+{
+    return std::strpbrk( address, "?*[{" ) != 0;
+}
+
+
+bool AddressPattern::Matches( const char *address ) const
+{
+    return MatchFrom( 0, address );
+}
+
+
+bool AddressPattern::MatchFrom( std::size_t token, const char *address ) const
+{
+    for( ; token < tokens_.size(); ++token ){
+        const Token& t = tokens_[token];
+
+        switch( t.type ){
+        case LITERAL_TOKEN:
+            if( std::strncmp( address, t.literal.c_str(), t.literal.size() ) != 0 )
+                return false;
+            address += t.literal.size();
+            break;
+
+        case ANY_CHAR_TOKEN:
+            if( *address == '\0' || *address == '/' )
+                return false;
+            ++address;
+            break;
+
+        case CHAR_SET_TOKEN:
+            if( !t.charSet.test( (unsigned char)*address ) )
+                return false;
+            ++address;
+            break;
+
+        case ALTERNATIVES_TOKEN:
+            for( std::size_t i = 0; i < t.alternatives.size(); ++i ){
+                const std::string& alternative = t.alternatives[i];
+                if( std::strncmp( address, alternative.c_str(), alternative.size() ) == 0
+                        && MatchFrom( token + 1, address + alternative.size() ) )
+                    return true;
+            }
+            return false;
+
+        case ANY_RUN_TOKEN:
+            // try every run length up to the end of this part of the address
+            for( ;; ){
+                if( MatchFrom( token + 1, address ) )
+                    return true;
+                if( *address == '\0' || *address == '/' )
+                    return false;
+                ++address;
+            }
+        }
+    }
+
+    return *address == '\0';
+}
+
+} // namespace osc
@@ -0,0 +1,49 @@
+#ifndef INCLUDED_OSCPACK_OSCADDRESSPATTERN_H
+#define INCLUDED_OSCPACK_OSCADDRESSPATTERN_H
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+
+namespace osc{
+
+/*
+    An OSC address pattern compiled once into a token list, so it can be
+    matched against many addresses without re-parsing it.
+    Supports the OSC 1.0 wildcards: ? * [abc] [a-z] [!abc] {foo,bar}.
+    None of the wildcards match across a '/'.
+*/
+class AddressPattern{
+public:
+    AddressPattern( const char *pattern );
+
+    bool Matches( const char *address ) const;
+
+    // true if the string contains any wildcard characters
+    static bool IsPattern( const char *address );
+
+private:
+    enum TokenType{
+        LITERAL_TOKEN,
+        ANY_CHAR_TOKEN,     // ?
+        ANY_RUN_TOKEN,      // *
+        CHAR_SET_TOKEN,     // [...]
+        ALTERNATIVES_TOKEN  // {...}
+    };
+
+    struct Token{
+        TokenType type;
+        std::string literal;
+        std::bitset<256> charSet;
+        std::vector< std::string > alternatives;
+    };
+
+    std::vector< Token > tokens_;
+
+    bool MatchFrom( std::size_t token, const char *address ) const;
+};
+
+} // namespace osc
+
+#endif /* INCLUDED_OSCPACK_OSCADDRESSPATTERN_H */